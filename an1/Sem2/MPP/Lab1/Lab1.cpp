@@ -2,6 +2,7 @@
 #include <fstream>
 #include <random>
 #include <chrono>
+#include "../Tools/perf_counters.h"
 using namespace std;
 
 const string INPUT_FILE_NAME = "input.txt";
@@ -123,8 +124,10 @@ double** product_of_matrix(uint32_t M, double** A, double** B) {
 int main()
 {
     ofstream fout("OUTPUT10k.txt");
+    PhaseProfiler perf(1);
     auto r_start = chrono::steady_clock::now();
     auto t_start = r_start;
+    perf.begin();
 
     read_M();
     cout << M << " " << FileA << " " << FileB << " " << FileC << endl;
@@ -133,26 +136,31 @@ int main()
     double** B = read_binary(M, FileB);
 
     auto r_final = chrono::steady_clock::now();
+    perf.end("Read", 0, 2.0 * M * M * sizeof(double));
     auto diff = r_final - r_start;
     cout << "computation time of the main thread FOR READ = " << chrono::duration <double, milli>(diff).count() << " ms" << endl;
     fout << "computation time of the main thread FOR READ = " << chrono::duration <double, milli>(diff).count() << " ms" << endl;
 
 
     auto c_start = chrono::steady_clock::now();
+    perf.begin();
 
     double** C = product_of_matrix(M, A, B);
 
     auto c_final = chrono::steady_clock::now();
+    perf.end("Computation", 2.0 * M * M * M, 3.0 * M * M * sizeof(double));
     diff = c_final - c_start;
     cout << "computation time of the main thread FOR COMPUTATION = " << chrono::duration <double, milli>(diff).count() << " ms" << endl;
     fout << "computation time of the main thread FOR COMPUTATION = " << chrono::duration <double, milli>(diff).count() << " ms" << endl;
 
 
     auto w_start = chrono::steady_clock::now();
+    perf.begin();
     //write(M, C, "output.txt");
     write_binary(M, C, FileC);
 
     auto w_final = chrono::steady_clock::now();
+    perf.end("Write", 0, 1.0 * M * M * sizeof(double));
     diff = w_final - w_start;
     cout << "computation time of the main thread FOR WRITE = " << chrono::duration <double, milli>(diff).count() << " ms" << endl;
     fout << "computation time of the main thread FOR WRITE = " << chrono::duration <double, milli>(diff).count() << " ms" << endl;
@@ -5,6 +5,9 @@
 #include <vector>
 #include <thread>
 #include <mutex>
+#include "../Tools/perf_counters.h"
+#include "../Tools/span_trace.h"
+#include "../Tools/mem_trace.h"
 
 using namespace std;
 
@@ -49,6 +52,7 @@ void write_binary(uint32_t M, double** mat, string fileName) {
 
 
 void multiply_rows(uint32_t start, uint32_t end, uint32_t M, double** A, double** B, double** C) {
+    TRACE_SPAN("multiply_rows");
     for (uint32_t i = start; i < end; ++i) {
         for (uint32_t j = 0; j < M; ++j) {
             C[i][j] = 0.0;
@@ -96,30 +100,47 @@ int main(int argc, char* argv[]) {
 
     ofstream fout("OUTPUT10k.txt");
 
+    PhaseProfiler perf(N);
+    mem_trace::MemoryTimeline mem(false);
+    span_trace::init();
     read_M();
     cout << "Matrix Size: " << M << ", Threads: " << N << endl;
 
     auto r_start = chrono::steady_clock::now();
+    perf.begin();
+    mem.begin();
     double** A = read_binary(M, FileA);
     double** B = read_binary(M, FileB);
     auto r_final = chrono::steady_clock::now();
+    perf.end("Read", 0, 2.0 * M * M * sizeof(double));
+    mem.end("Read");
 
     cout << "Read time: " << chrono::duration<double, milli>(r_final - r_start).count() << " ms" << endl;
 
     auto c_start = chrono::steady_clock::now();
+    perf.begin();
+    mem.begin();
     double** C = product_of_matrix(M, A, B, N);
     auto c_final = chrono::steady_clock::now();
+    perf.end("Computation", 2.0 * M * M * M, 3.0 * M * M * sizeof(double));
+    mem.end("Computation");
 
     cout << "Computation time: " << chrono::duration<double, milli>(c_final - c_start).count() << " ms" << endl;
 
     auto w_start = chrono::steady_clock::now();
+    perf.begin();
+    mem.begin();
     write_binary(M, C, FileC);
     auto w_final = chrono::steady_clock::now();
+    perf.end("Write", 0, 1.0 * M * M * sizeof(double));
+    mem.end("Write");
 
     cout << "Write time: " << chrono::duration<double, milli>(w_final - w_start).count() << " ms" << endl;
 
     auto t_final = chrono::steady_clock::now();
     cout << "Total execution time: " << chrono::duration<double, milli>(t_final - r_start).count() << " ms" << endl;
 
+    mem.report();
+    span_trace::finish();
     return 0;
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <vector>
 #include <thread>
 #include <mutex>
+#include "../Tools/perf_counters.h"
 using namespace std;
 
 const string INPUT_FILE_NAME = "input.txt";
@@ -175,8 +176,10 @@ int main(int argc, char* argv[]) {
     }
 
     ofstream fout("OUTPUT10k.txt");
+    PhaseProfiler perf(N);
     auto r_start = chrono::steady_clock::now();
     auto t_start = r_start;
+    perf.begin();
 
     read_M();
     cout << M << " " << FileA << " " << FileB << " " << FileC << endl;
@@ -185,25 +188,30 @@ int main(int argc, char* argv[]) {
     double** B = read_binary_parallel(M, FileB, N);
 
     auto r_final = chrono::steady_clock::now();
+    perf.end("Read", 0, 2.0 * M * M * sizeof(double));
     auto diff = r_final - r_start;
     cout << "computation time of the main thread FOR READ = " << chrono::duration <double, milli>(diff).count() << " ms" << endl;
     fout << "computation time of the main thread FOR READ = " << chrono::duration <double, milli>(diff).count() << " ms" << endl;
 
 
     auto c_start = chrono::steady_clock::now();
+    perf.begin();
 
     double** C = product_of_matrix(M, A, B, N);
 
     auto c_final = chrono::steady_clock::now();
+    perf.end("Computation", 2.0 * M * M * M, 3.0 * M * M * sizeof(double));
     diff = c_final - c_start;
     cout << "computation time of the main thread FOR COMPUTATION = " << chrono::duration <double, milli>(diff).count() << " ms" << endl;
     fout << "computation time of the main thread FOR COMPUTATION = " << chrono::duration <double, milli>(diff).count() << " ms" << endl;
 
 
     auto w_start = chrono::steady_clock::now();
+    perf.begin();
     write_binary(M, C, FileC);
 
     auto w_final = chrono::steady_clock::now();
+    perf.end("Write", 0, 1.0 * M * M * sizeof(double));
     diff = w_final - w_start;
     cout << "computation time of the main thread FOR WRITE = " << chrono::duration <double, milli>(diff).count() << " ms" << endl;
     fout << "computation time of the main thread FOR WRITE = " << chrono::duration <double, milli>(diff).count() << " ms" << endl;
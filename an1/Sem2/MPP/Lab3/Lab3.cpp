@@ -3,6 +3,10 @@
 #include <vector>
 #include <chrono>
 #include <omp.h>
+#include "../Tools/perf_counters.h"
+#include "../Tools/span_trace.h"
+#include "../Tools/mem_trace.h"
+#include "../Tools/matrix_codec.h"
 
 using namespace std;
 using namespace std::chrono;
@@ -17,14 +21,77 @@ void read_input(const string& input_file, int& M, string& fileA, string& fileB,
     fin.close();
 }
 
+string get_option(int argc, char* argv[], const string& name, const string& def) {
+    string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0)
+            return arg.substr(prefix.size());
+    }
+    return def;
+}
+
+// C = A B for M x M row-major matrices; C must not alias A or B.
+void multiply(const double* A, const double* B, double* C, int M) {
+    // nowait ends each thread's span at its last iteration, so the time it
+    // then idles at the region's closing barrier shows up in the trace
+#pragma omp parallel
+    {
+        TRACE_SPAN("omp_for");
+#pragma omp for collapse(2) nowait
+        for (int i = 0; i < M; ++i) {
+            for (int j = 0; j < M; ++j) {
+                double sum = 0.0;
+                for (int k = 0; k < M; ++k) {
+                    sum += A[i * M + k] * B[k * M + j];
+                }
+                C[i * M + j] = sum;
+            }
+        }
+    }
+}
+
+// C = A^k by repeated squaring: A holds the running square and B is the
+// scratch buffer, so no matrix is allocated or written between steps.
+// Returns the number of multiplications (at most 2 log2 k).
+int matrix_power(vector<double>& A, vector<double>& B, vector<double>& C, int M, int k) {
+    int multiplications = 0;
+    bool have_result = false;
+    while (k > 0) {
+        if (k & 1) {
+            if (!have_result) {
+                C = A;
+                have_result = true;
+            }
+            else {
+                multiply(C.data(), A.data(), B.data(), M);
+                C.swap(B);
+                ++multiplications;
+            }
+        }
+        k >>= 1;
+        if (k > 0) {
+            multiply(A.data(), A.data(), B.data(), M);
+            A.swap(B);
+            ++multiplications;
+        }
+    }
+    return multiplications;
+}
+
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        cerr << "Usage: " << argv[0] << " <num_threads>\n";
+        cerr << "Usage: " << argv[0] << " <num_threads> [--power=k]\n";
         return 1;
     }
 
     int num_threads = stoi(argv[1]);
+    // --power=k computes A^k into C instead of A B (B is not read)
+    int power = stoi(get_option(argc, argv, "power", "0"));
     omp_set_num_threads(num_threads);
+    PhaseProfiler perf(num_threads);
+    mem_trace::MemoryTimeline mem(false);
+    span_trace::init();
 
     int M;
     string fileA, fileB, fileC;
@@ -38,39 +105,47 @@ int main(int argc, char* argv[]) {
 
     // Reading matrices from binary files
     auto r_start = steady_clock::now();
-    ifstream fa(fileA, ios::binary);
-    ifstream fb(fileB, ios::binary);
-    fa.read(reinterpret_cast<char*>(A.data()), M * M * sizeof(double));
-    fb.read(reinterpret_cast<char*>(B.data()), M * M * sizeof(double));
-    fa.close(); fb.close();
+    perf.begin();
+    mem.begin();
+    // Raw .bin or compressed .mtxz inputs, told apart by the file's magic
+    if (!matrix_codec::read_matrix(fileA, A.data(), M) || (power == 0 && !matrix_codec::read_matrix(fileB, B.data(), M)))
+        exit(1);
     auto r_final = steady_clock::now();
+    perf.end("Read", 0, (power > 0 ? 1.0 : 2.0) * M * M * sizeof(double));
+    mem.end("Read");
     cout << "Read time: " << duration<double, milli>(r_final - r_start).count() << " ms" << endl;
 
     // Matrix multiplication (parallel)
     auto m_start = steady_clock::now();
-#pragma omp parallel for collapse(2)
-    for (int i = 0; i < M; ++i) {
-        for (int j = 0; j < M; ++j) {
-            double sum = 0.0;
-            for (int k = 0; k < M; ++k) {
-                sum += A[i * M + k] * B[k * M + j];
-            }
-            C[i * M + j] = sum;
-        }
-    }
+    perf.begin();
+    mem.begin();
+    int multiplications = 1;
+    if (power > 0)
+        multiplications = matrix_power(A, B, C, M, power);
+    else
+        multiply(A.data(), B.data(), C.data(), M);
     auto m_final = steady_clock::now();
+    perf.end("Multiplication", 2.0 * M * M * M * multiplications, 3.0 * M * M * sizeof(double) * multiplications);
+    mem.end("Multiplication");
+    if (power > 0)
+        cout << "A^" << power << " with " << multiplications << " multiplications" << endl;
     cout << "Matrix multiplication time: " << duration<double, milli>(m_final - m_start).count() << " ms" << endl;
 
     // Writing the result matrix C to a binary file
     auto w_start = steady_clock::now();
-    ofstream fc(fileC, ios::binary);
-    fc.write(reinterpret_cast<char*>(C.data()), M * M * sizeof(double));
-    fc.close();
+    perf.begin();
+    mem.begin();
+    // An output name ending in .mtxz is written compressed
+    if (!matrix_codec::write_matrix(fileC, C.data(), M)) exit(1);
     auto w_final = steady_clock::now();
+    perf.end("Write", 0, 1.0 * M * M * sizeof(double));
+    mem.end("Write");
     cout << "Write time: " << duration<double, milli>(w_final - w_start).count() << " ms" << endl;
 
     auto total_final = steady_clock::now();
     cout << "Total execution time: " << duration<double, milli>(total_final - start_total).count() << " ms" << endl;
 
+    mem.report();
+    span_trace::finish();
     return 0;
 }
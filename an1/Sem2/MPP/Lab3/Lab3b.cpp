@@ -3,6 +3,10 @@
 #include <vector>
 #include <chrono>
 #include <omp.h>
+#include "../Tools/perf_counters.h"
+#include "../Tools/span_trace.h"
+#include "../Tools/mem_trace.h"
+#include "../Tools/matrix_codec.h"
 
 using namespace std;
 using namespace std::chrono;
@@ -25,6 +29,9 @@ int main(int argc, char* argv[]) {
 
     int num_threads = stoi(argv[1]);
     omp_set_num_threads(num_threads);
+    PhaseProfiler perf(num_threads);
+    mem_trace::MemoryTimeline mem(false);
+    span_trace::init();
 
     int M;
     string fileA, fileB, fileC;
@@ -36,52 +43,67 @@ int main(int argc, char* argv[]) {
 
     auto start_total = steady_clock::now();
 
-    // Parallel reading of matrices from binary files
+    // Parallel reading of matrices from binary files (raw .bin or compressed .mtxz)
     auto r_start = steady_clock::now();
+    perf.begin();
+    mem.begin();
 #pragma omp parallel sections
     {
 #pragma omp section
         {
-            ifstream fa(fileA, ios::binary);
-            fa.read(reinterpret_cast<char*>(A.data()), M * M * sizeof(double));
-            fa.close();
+            if (!matrix_codec::read_matrix(fileA, A.data(), M)) exit(1);
         }
 
 #pragma omp section
         {
-            ifstream fb(fileB, ios::binary);
-            fb.read(reinterpret_cast<char*>(B.data()), M * M * sizeof(double));
-            fb.close();
+            if (!matrix_codec::read_matrix(fileB, B.data(), M)) exit(1);
         }
     }
     auto r_final = steady_clock::now();
+    perf.end("Read", 0, 2.0 * M * M * sizeof(double));
+    mem.end("Read");
     cout << "Read time: " << duration<double, milli>(r_final - r_start).count() << " ms" << endl;
 
     // Matrix multiplication (parallel)
     auto m_start = steady_clock::now();
-#pragma omp parallel for collapse(2)
-    for (int i = 0; i < M; ++i) {
-        for (int j = 0; j < M; ++j) {
-            double sum = 0.0;
-            for (int k = 0; k < M; ++k) {
-                sum += A[i * M + k] * B[k * M + j];
+    perf.begin();
+    mem.begin();
+    // nowait ends each thread's span at its last iteration, so the time it
+    // then idles at the region's closing barrier shows up in the trace
+#pragma omp parallel
+    {
+        TRACE_SPAN("omp_for");
+#pragma omp for collapse(2) nowait
+        for (int i = 0; i < M; ++i) {
+            for (int j = 0; j < M; ++j) {
+                double sum = 0.0;
+                for (int k = 0; k < M; ++k) {
+                    sum += A[i * M + k] * B[k * M + j];
+                }
+                C[i * M + j] = sum;
             }
-            C[i * M + j] = sum;
         }
     }
     auto m_final = steady_clock::now();
+    perf.end("Multiplication", 2.0 * M * M * M, 3.0 * M * M * sizeof(double));
+    mem.end("Multiplication");
     cout << "Matrix multiplication time: " << duration<double, milli>(m_final - m_start).count() << " ms" << endl;
 
     // Writing the result matrix C to a binary file
     auto w_start = steady_clock::now();
-    ofstream fc(fileC, ios::binary);
-    fc.write(reinterpret_cast<char*>(C.data()), M * M * sizeof(double));
-    fc.close();
+    perf.begin();
+    mem.begin();
+    // An output name ending in .mtxz is written compressed
+    if (!matrix_codec::write_matrix(fileC, C.data(), M)) exit(1);
     auto w_final = steady_clock::now();
+    perf.end("Write", 0, 1.0 * M * M * sizeof(double));
+    mem.end("Write");
     cout << "Write time: " << duration<double, milli>(w_final - w_start).count() << " ms" << endl;
 
     auto total_final = steady_clock::now();
     cout << "Total execution time: " << duration<double, milli>(total_final - start_total).count() << " ms" << endl;
 
+    mem.report();
+    span_trace::finish();
     return 0;
 }
@@ -0,0 +1,202 @@
+#include <mpi.h>
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <chrono>
+
+using namespace std;
+using namespace std::chrono;
+
+const string INPUT_FILE_NAME = "input.txt";
+
+int M;
+string FileA, FileB, FileC;
+
+string get_option(int argc, char* argv[], const string& name, const string& def) {
+    string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0)
+            return arg.substr(prefix.size());
+    }
+    return def;
+}
+
+void read_input() {
+    ifstream rf(INPUT_FILE_NAME);
+    if (!rf.is_open()) {
+        cerr << "Cannot open input file!" << endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    rf >> M >> FileA >> FileB >> FileC;
+}
+
+MPI_Datatype block_filetype(int block_size, int row, int col) {
+    int sizes[2] = { M, M };
+    int subsizes[2] = { block_size, block_size };
+    int starts[2] = { row * block_size, col * block_size };
+    MPI_Datatype filetype;
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_DOUBLE, &filetype);
+    MPI_Type_commit(&filetype);
+    return filetype;
+}
+
+void read_block(double* block, const string& fileName, int block_size, int row, int col, MPI_Comm comm) {
+    MPI_Datatype filetype = block_filetype(block_size, row, col);
+    MPI_File file;
+    if (MPI_File_open(comm, fileName.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        cerr << "Cannot open matrix file " << fileName << endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_set_view(file, 0, MPI_DOUBLE, filetype, "native", MPI_INFO_NULL);
+    MPI_File_read_all(file, block, block_size * block_size, MPI_DOUBLE, MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+    MPI_Type_free(&filetype);
+}
+
+void write_block(const double* block, const string& fileName, int block_size, int row, int col, MPI_Comm comm) {
+    MPI_Datatype filetype = block_filetype(block_size, row, col);
+    MPI_File file;
+    if (MPI_File_open(comm, fileName.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        cerr << "Cannot open output file " << fileName << endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_set_size(file, static_cast<MPI_Offset>(M) * M * sizeof(double));
+    MPI_File_set_view(file, 0, MPI_DOUBLE, filetype, "native", MPI_INFO_NULL);
+    MPI_File_write_all(file, block, block_size * block_size, MPI_DOUBLE, MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+    MPI_Type_free(&filetype);
+}
+
+void matrix_mult_block(const double* A, const double* B, double* C, int block_size) {
+    for (int i = 0; i < block_size; ++i) {
+        for (int k = 0; k < block_size; ++k) {
+            double a = A[i * block_size + k];
+            for (int j = 0; j < block_size; ++j)
+                C[i * block_size + j] += a * B[k * block_size + j];
+        }
+    }
+}
+
+// Shifts a block `steps` positions towards lower coordinates along `dim`.
+void shift_block(double* block, int block_len, int dim, int steps, MPI_Comm layer_comm) {
+    int src, dst;
+    MPI_Cart_shift(layer_comm, dim, -steps, &src, &dst);
+    MPI_Sendrecv_replace(block, block_len, MPI_DOUBLE, dst, 0, src, 0, layer_comm, MPI_STATUS_IGNORE);
+}
+
+int main(int argc, char* argv[]) {
+    MPI_Init(&argc, &argv);
+
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // P = q * q * c: c layers of a q x q Cannon grid, each layer doing q / c steps
+    int c = stoi(get_option(argc, argv, "c", "2"));
+    if (c < 1) {
+        if (rank == 0) cerr << "Replication factor c must be at least 1 (c = " << c << ")." << endl;
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+    int q = static_cast<int>(round(sqrt(static_cast<double>(size) / c)));
+    if (q * q * c != size || q % c != 0) {
+        if (rank == 0) cerr << "Number of processes must be q*q*c with c dividing q (c = " << c << ")." << endl;
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+
+    read_input();
+    if (M % q != 0) {
+        if (rank == 0) cerr << "Matrix size M must be divisible by q = " << q << "." << endl;
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+    int block_size = M / q;
+    int block_len = block_size * block_size;
+
+    int dims[3] = { q, q, c }, periods[3] = { 1, 1, 0 };
+    MPI_Comm grid_comm, layer_comm, depth_comm;
+    MPI_Cart_create(MPI_COMM_WORLD, 3, dims, periods, 1, &grid_comm);
+    int grid_rank, coords[3];
+    MPI_Comm_rank(grid_comm, &grid_rank);
+    MPI_Cart_coords(grid_comm, grid_rank, 3, coords);
+    int row = coords[0], col = coords[1], layer = coords[2];
+
+    int layer_dims[3] = { 1, 1, 0 }, depth_dims[3] = { 0, 0, 1 };
+    MPI_Cart_sub(grid_comm, layer_dims, &layer_comm);
+    MPI_Cart_sub(grid_comm, depth_dims, &depth_comm);
+
+    vector<double> A_block(block_len), B_block(block_len), C_block(block_len, 0.0);
+
+    // Layer 0 reads the blocks, then they are replicated along the depth dimension
+    auto read_start = steady_clock::now();
+    if (layer == 0) {
+        read_block(A_block.data(), FileA, block_size, row, col, layer_comm);
+        read_block(B_block.data(), FileB, block_size, row, col, layer_comm);
+    }
+    auto read_end = steady_clock::now();
+    double read_time = duration<double, milli>(read_end - read_start).count();
+
+    auto comp_start = steady_clock::now();
+    double t0 = MPI_Wtime();
+    MPI_Bcast(A_block.data(), block_len, MPI_DOUBLE, 0, depth_comm);
+    MPI_Bcast(B_block.data(), block_len, MPI_DOUBLE, 0, depth_comm);
+    double t_replicate = MPI_Wtime() - t0;
+
+    // Layer l covers k = (row + col + l*q/c + s) mod q for s < q/c
+    int steps = q / c;
+    int offset = layer * steps;
+    t0 = MPI_Wtime();
+    shift_block(A_block.data(), block_len, 1, row + offset, layer_comm);
+    shift_block(B_block.data(), block_len, 0, col + offset, layer_comm);
+    double t_shift = MPI_Wtime() - t0;
+
+    for (int step = 0; step < steps; ++step) {
+        matrix_mult_block(A_block.data(), B_block.data(), C_block.data(), block_size);
+        if (step + 1 < steps) {
+            t0 = MPI_Wtime();
+            shift_block(A_block.data(), block_len, 1, 1, layer_comm);
+            shift_block(B_block.data(), block_len, 0, 1, layer_comm);
+            t_shift += MPI_Wtime() - t0;
+        }
+    }
+
+    t0 = MPI_Wtime();
+    vector<double> C_sum(layer == 0 ? block_len : 0);
+    MPI_Reduce(C_block.data(), C_sum.data(), block_len, MPI_DOUBLE, MPI_SUM, 0, depth_comm);
+    double t_reduce = MPI_Wtime() - t0;
+
+    auto comp_end = steady_clock::now();
+    double comp_time = duration<double, milli>(comp_end - comp_start).count();
+
+    auto write_start = steady_clock::now();
+    if (layer == 0)
+        write_block(C_sum.data(), FileC, block_size, row, col, layer_comm);
+    auto write_end = steady_clock::now();
+    double write_time = duration<double, milli>(write_end - write_start).count();
+
+    double local[3] = { t_replicate, t_shift, t_reduce }, comm_max[3];
+    MPI_Reduce(local, comm_max, 3, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    double total_time = duration<double, milli>(write_end - read_start).count();
+    if (rank == 0) {
+        // Per rank: Cannon moves 2(q/c + 1) blocks instead of 2(q + 1), at the
+        // cost of c copies of A, B and C and the replication / reduction
+        cout << "Matrix size: " << M << " Grid: " << q << "x" << q << "x" << c << endl;
+        cout << "Read time: " << read_time << " ms" << endl;
+        cout << "Computation time: " << comp_time << " ms" << endl;
+        cout << "  Replication: " << comm_max[0] * 1000.0 << " ms, Shifts: " << comm_max[1] * 1000.0
+             << " ms, Reduction: " << comm_max[2] * 1000.0 << " ms" << endl;
+        cout << "Write time: " << write_time << " ms" << endl;
+        cout << "Total execution time: " << total_time << " ms" << endl;
+    }
+
+    MPI_Comm_free(&layer_comm);
+    MPI_Comm_free(&depth_comm);
+    MPI_Comm_free(&grid_comm);
+    MPI_Finalize();
+    return 0;
+}
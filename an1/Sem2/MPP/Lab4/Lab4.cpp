@@ -4,6 +4,11 @@
 #include <vector>
 #include <cmath>
 #include <chrono>
+#include <algorithm>
+#include <string>
+#include "../Tools/mem_trace.h"
+#include "../Tools/perf_counters.h"
+#include "../Tools/block_io.h"
 
 using namespace std;
 using namespace chrono;
@@ -13,6 +18,16 @@ const string INPUT_FILE_NAME = "input.txt";
 uint32_t M;
 string FileA, FileB, FileC;
 
+string get_option(int argc, char** argv, const string& name, const string& def) {
+    string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0)
+            return arg.substr(prefix.size());
+    }
+    return def;
+}
+
 void read_input() {
     ifstream rf(INPUT_FILE_NAME);
     if (!rf.is_open()) {
@@ -49,9 +64,99 @@ void matrix_mult_block(double* A, double* B, double* C, int block_size) {
                 C[i * block_size + j] += A[i * block_size + k] * B[k * block_size + j];
 }
 
+// Broadcast-based (Fox) multiplication: at step s the A block of column
+// (row + s) % q is broadcast along the row, multiplied with the local B block,
+// and B moves one block up the column. Returns the time spent communicating.
+double fox_blocking(double* A_block, double* B_block, double* C_block, int block_size, int q,
+                    int row, int col, MPI_Comm row_comm, MPI_Comm col_comm) {
+    int block_len = block_size * block_size;
+    vector<double> A_panel(block_len);
+    double t_comm = 0.0;
+
+    for (int step = 0; step < q; step++) {
+        int src = (row + step) % q;
+        if (src == col)
+            copy(A_block, A_block + block_len, A_panel.begin());
+
+        double c0 = MPI_Wtime();
+        MPI_Bcast(A_panel.data(), block_len, MPI_DOUBLE, src, row_comm);
+        t_comm += MPI_Wtime() - c0;
+
+        matrix_mult_block(A_panel.data(), B_block, C_block, block_size);
+
+        if (step + 1 < q) {
+            c0 = MPI_Wtime();
+            MPI_Sendrecv_replace(B_block, block_len, MPI_DOUBLE,
+                                 (row - 1 + q) % q, 0,
+                                 (row + 1) % q, 0,
+                                 col_comm, MPI_STATUS_IGNORE);
+            t_comm += MPI_Wtime() - c0;
+        }
+    }
+    return t_comm;
+}
+
+// Double-buffered variant: the A panel and B block of step s + 1 are in flight
+// (MPI_Ibcast, MPI_Isend/MPI_Irecv) while step s is multiplied. Returns the
+// communication time that was not hidden behind the multiplication.
+double fox_overlap(double* A_block, double* B_block, double* C_block, int block_size, int q,
+                   int row, int col, MPI_Comm row_comm, MPI_Comm col_comm) {
+    int block_len = block_size * block_size;
+    vector<double> A_panel[2] = { vector<double>(block_len), vector<double>(block_len) };
+    vector<double> B_buf[2] = { vector<double>(B_block, B_block + block_len), vector<double>(block_len) };
+    MPI_Request reqs[3];
+    double t_exposed = 0.0;
+
+    double c0 = MPI_Wtime();
+    if (row == col)
+        copy(A_block, A_block + block_len, A_panel[0].begin());
+    MPI_Bcast(A_panel[0].data(), block_len, MPI_DOUBLE, row, row_comm);
+    t_exposed += MPI_Wtime() - c0;
+
+    for (int step = 0; step < q; step++) {
+        int cur = step & 1, nxt = cur ^ 1;
+        int n_reqs = 0;
+
+        if (step + 1 < q) {
+            int src = (row + step + 1) % q;
+            if (src == col)
+                copy(A_block, A_block + block_len, A_panel[nxt].begin());
+            MPI_Ibcast(A_panel[nxt].data(), block_len, MPI_DOUBLE, src, row_comm, &reqs[n_reqs++]);
+            MPI_Irecv(B_buf[nxt].data(), block_len, MPI_DOUBLE, (row + 1) % q, 0, col_comm, &reqs[n_reqs++]);
+            MPI_Isend(B_buf[cur].data(), block_len, MPI_DOUBLE, (row - 1 + q) % q, 0, col_comm, &reqs[n_reqs++]);
+        }
+
+        matrix_mult_block(A_panel[cur].data(), B_buf[cur].data(), C_block, block_size);
+
+        c0 = MPI_Wtime();
+        MPI_Waitall(n_reqs, reqs, MPI_STATUSES_IGNORE);
+        t_exposed += MPI_Wtime() - c0;
+    }
+    return t_exposed;
+}
+
+// Cost of one blocking step's communication (panel broadcast and B shift),
+// measured on scratch buffers to estimate how much the overlap hides.
+void measure_step_comm(int block_size, int q, int row, MPI_Comm row_comm, MPI_Comm col_comm,
+                       double& t_bcast, double& t_shift) {
+    int block_len = block_size * block_size;
+    vector<double> scratch(block_len, 0.0);
+    MPI_Barrier(MPI_COMM_WORLD);
+    double c0 = MPI_Wtime();
+    MPI_Bcast(scratch.data(), block_len, MPI_DOUBLE, row, row_comm);
+    t_bcast = MPI_Wtime() - c0;
+    c0 = MPI_Wtime();
+    MPI_Sendrecv_replace(scratch.data(), block_len, MPI_DOUBLE, (row - 1 + q) % q, 0,
+                         (row + 1) % q, 0, col_comm, MPI_STATUS_IGNORE);
+    t_shift = MPI_Wtime() - c0;
+}
+
 int main(int argc, char** argv) {
     MPI_Init(&argc, &argv);
 
+    string mode = get_option(argc, argv, "mode", "blocking");
+    string dist = get_option(argc, argv, "dist", "mpiio");
+
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
@@ -67,75 +172,120 @@ int main(int argc, char** argv) {
     MPI_Comm grid_comm;
     MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 1, &grid_comm);
 
+    // Reordering may give this process another rank in grid_comm
+    int grid_rank;
+    MPI_Comm_rank(grid_comm, &grid_rank);
     int coords[2];
-    MPI_Cart_coords(grid_comm, rank, 2, coords);
+    MPI_Cart_coords(grid_comm, grid_rank, 2, coords);
     int row = coords[0], col = coords[1];
 
-    if (rank == 0) read_input();
-    MPI_Bcast(&M, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
+    read_input();
+    if (M % q != 0) {
+        if (rank == 0) cerr << "Matrix size M must be divisible by sqrt(number of processes)." << endl;
+        MPI_Finalize();
+        return 1;
+    }
 
     int block_size = M / q;
     vector<double> A_block(block_size * block_size, 0.0);
     vector<double> B_block(block_size * block_size, 0.0);
     vector<double> C_block(block_size * block_size, 0.0);
 
-    vector<double> A, B;
+    // Hardware counters (MPP_PERF=1) cover rank 0's share of the work; with
+    // counters on, the barrier keeps its roofline measurement out of the timings
+    PhaseProfiler perf(1, rank == 0);
+    mem_trace::MemoryTimeline mem(false);
+    if (PhaseProfiler::requested()) MPI_Barrier(grid_comm);
     auto t_start = steady_clock::now();
     auto read_start = t_start;
+    mem.begin();
 
-    if (rank == 0) {
-        A.resize(M * M);
-        B.resize(M * M);
-        read_matrix_binary(A.data(), M, FileA);
-        read_matrix_binary(B.data(), M, FileB);
-    }
+    if (dist == "scatter") {
+        // Legacy path: one rank holds both full matrices and scatters the blocks
+        vector<double> A, B;
+        if (grid_rank == 0) {
+            A.resize(M * M);
+            B.resize(M * M);
+            read_matrix_binary(A.data(), M, FileA);
+            read_matrix_binary(B.data(), M, FileB);
+        }
 
-    MPI_Scatter(A.data(), block_size * block_size, MPI_DOUBLE, A_block.data(), block_size * block_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-    MPI_Scatter(B.data(), block_size * block_size, MPI_DOUBLE, B_block.data(), block_size * block_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        block_io::scatter_matrix(A.data(), A_block.data(), M, block_size, grid_comm);
+        block_io::scatter_matrix(B.data(), B_block.data(), M, block_size, grid_comm);
+    }
+    else if (dist == "stream") {
+        block_io::read_block_stream(A_block.data(), FileA, M, block_size, q, grid_comm);
+        block_io::read_block_stream(B_block.data(), FileB, M, block_size, q, grid_comm);
+    }
+    else {
+        block_io::read_block(A_block.data(), FileA, M, block_size, row, col, grid_comm);
+        block_io::read_block(B_block.data(), FileB, M, block_size, row, col, grid_comm);
+    }
 
     auto read_end = steady_clock::now();
+    mem.end("Reading");
+    mem.begin();
     if (rank == 0) cout << "Reading Time: " << duration<double, milli>(read_end - read_start).count() << " ms" << endl;
 
     MPI_Comm row_comm, col_comm;
     MPI_Comm_split(grid_comm, row, col, &row_comm);
     MPI_Comm_split(grid_comm, col, row, &col_comm);
 
-    MPI_Status status;
-    for (int step = 0; step < q; step++) {
-        int src = (row + step) % q;
-        int A_root_rank;
-		int A_coords[2] = {row, src};
-        MPI_Cart_rank(grid_comm, A_coords, &A_root_rank);
-
-        if (src == col)
-            matrix_mult_block(A_block.data(), B_block.data(), C_block.data(), block_size);
-
-        MPI_Bcast(A_block.data(), block_size * block_size, MPI_DOUBLE, src, row_comm);
+    perf.begin();
+    if (mode == "overlap") {
+        double t_bcast, t_shift;
+        measure_step_comm(block_size, q, row, row_comm, col_comm, t_bcast, t_shift);
+        double t_estimate = q * t_bcast + (q - 1) * t_shift;
+        double t_exposed = fox_overlap(A_block.data(), B_block.data(), C_block.data(), block_size, q,
+                                       row, col, row_comm, col_comm);
 
-        MPI_Sendrecv_replace(B_block.data(), block_size * block_size, MPI_DOUBLE,
-                             (col + 1) % q, 0,
-                             (col - 1 + q) % q, 0,
-                             col_comm, &status);
+        double local[2] = { t_estimate, t_exposed }, global[2];
+        MPI_Reduce(local, global, 2, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        if (rank == 0) {
+            double hidden = max(0.0, global[0] - global[1]);
+            cout << "Communication Time (blocking estimate): " << global[0] * 1000.0 << " ms" << endl;
+            cout << "Communication Time (exposed): " << global[1] * 1000.0 << " ms" << endl;
+            cout << "Communication Hidden: " << hidden * 1000.0 << " ms ("
+                 << (global[0] > 0.0 ? 100.0 * hidden / global[0] : 0.0) << "%)" << endl;
+        }
+    }
+    else {
+        double t_comm = fox_blocking(A_block.data(), B_block.data(), C_block.data(), block_size, q,
+                              row, col, row_comm, col_comm);
+        double t_comm_max;
+        MPI_Reduce(&t_comm, &t_comm_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        if (rank == 0) cout << "Communication Time: " << t_comm_max * 1000.0 << " ms" << endl;
     }
 
-    vector<double> C;
-    if (rank == 0) C.resize(M * M);
+    perf.end("Computation (rank 0)", 2.0 * block_size * block_size * M,
+             (2.0 * q + 1) * block_size * block_size * sizeof(double));
 
-    MPI_Gather(C_block.data(), block_size * block_size, MPI_DOUBLE,
-               C.data(), block_size * block_size, MPI_DOUBLE,
-               0, MPI_COMM_WORLD);
+    vector<double> C;
+    if (dist == "scatter") {
+        if (grid_rank == 0) C.resize(M * M);
+        block_io::gather_matrix(C_block.data(), C.data(), M, block_size, grid_comm);
+    }
 
     auto comp_end = steady_clock::now();
+    mem.end("Computation");
     if (rank == 0) cout << "Computation Time: " << duration<double, milli>(comp_end - read_end).count() << " ms" << endl;
 
     auto write_start = steady_clock::now();
-    if (rank == 0) write_matrix_binary(C.data(), M, FileC);
+    mem.begin();
+    if (dist == "scatter") {
+        if (grid_rank == 0) write_matrix_binary(C.data(), M, FileC);
+    }
+    else {
+        block_io::write_block(C_block.data(), FileC, M, block_size, row, col, grid_comm);
+    }
     auto write_end = steady_clock::now();
+    mem.end("Writing");
 
     if (rank == 0) {
         cout << "Writing Time: " << duration<double, milli>(write_end - write_start).count() << " ms" << endl;
         cout << "Total Time: " << duration<double, milli>(write_end - t_start).count() << " ms" << endl;
     }
+    mem.report(MPI_COMM_WORLD);
 
     MPI_Comm_free(&row_comm);
     MPI_Comm_free(&col_comm);
@@ -4,16 +4,216 @@
 #include <cmath>
 #include <vector>
 #include <chrono>
+#include <string>
+#include <algorithm>
+#include "../Tools/perf_counters.h"
+#include "../Tools/span_trace.h"
+#include "../Tools/mem_trace.h"
+#include "../Tools/block_io.h"
 
 using namespace std;
 using namespace std::chrono;
 
+string get_option(int argc, char* argv[], const string& name, const string& def) {
+    string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0)
+            return arg.substr(prefix.size());
+    }
+    return def;
+}
+
+void multiply_block(const double* A, const double* B, double* C, int block_size) {
+    for (int i = 0; i < block_size; ++i) {
+        for (int j = 0; j < block_size; ++j) {
+            double sum = 0.0;
+            for (int k = 0; k < block_size; ++k) {
+                sum += A[i * block_size + k] * B[k * block_size + j];
+            }
+            C[i * block_size + j] += sum;
+        }
+    }
+}
+
+// Cannon over a node-shared window: blocks never move. At step s rank (i, j)
+// needs A(i, k) and B(k, j) with k = (i + j + s) mod q; blocks of ranks on the
+// same node are read in place from the window, the others are received from
+// their owners (each owner sends at most one A and one B per step). The next
+// step's messages are posted before the current block is multiplied.
+// Returns the number of blocks this rank received over MPI.
+int cannon_shm(const double* A_local, const double* B_local, double* C_block, int block_size, int q,
+               int row, int col, MPI_Comm cart_comm, MPI_Comm node_comm, MPI_Win win) {
+    int block_len = block_size * block_size;
+
+    // Window segment of every cart rank on this node, nullptr for remote ones
+    vector<const double*> node_base(q * q, nullptr);
+    MPI_Group cart_group, node_group;
+    MPI_Comm_group(cart_comm, &cart_group);
+    MPI_Comm_group(node_comm, &node_group);
+    vector<int> cart_ranks(q * q), node_ranks(q * q);
+    for (int r = 0; r < q * q; ++r) cart_ranks[r] = r;
+    MPI_Group_translate_ranks(cart_group, q * q, cart_ranks.data(), node_group, node_ranks.data());
+    for (int r = 0; r < q * q; ++r) {
+        if (node_ranks[r] == MPI_UNDEFINED) continue;
+        MPI_Aint seg_size;
+        int disp_unit;
+        double* base;
+        MPI_Win_shared_query(win, node_ranks[r], &seg_size, &disp_unit, &base);
+        node_base[r] = base;
+    }
+    MPI_Group_free(&cart_group);
+    MPI_Group_free(&node_group);
+
+    auto cart_rank = [&](int i, int j) {
+        int c[2] = { (i + q) % q, (j + q) % q }, r;
+        MPI_Cart_rank(cart_comm, c, &r);
+        return r;
+    };
+
+    vector<double> A_recv[2] = { vector<double>(block_len), vector<double>(block_len) };
+    vector<double> B_recv[2] = { vector<double>(block_len), vector<double>(block_len) };
+    const double* A_step[2];
+    const double* B_step[2];
+    MPI_Request reqs[2][4];
+    int received = 0;
+
+    auto start_step = [&](int s) {
+        int b = s & 1;
+        for (int r = 0; r < 4; ++r) reqs[b][r] = MPI_REQUEST_NULL;
+        int k = (row + col + s) % q;
+
+        int a_owner = cart_rank(row, k);
+        if (node_base[a_owner]) {
+            A_step[b] = node_base[a_owner];
+        } else {
+            MPI_Irecv(A_recv[b].data(), block_len, MPI_DOUBLE, a_owner, 0, cart_comm, &reqs[b][0]);
+            A_step[b] = A_recv[b].data();
+            ++received;
+        }
+        int b_owner = cart_rank(k, col);
+        if (node_base[b_owner]) {
+            B_step[b] = node_base[b_owner] + block_len;
+        } else {
+            MPI_Irecv(B_recv[b].data(), block_len, MPI_DOUBLE, b_owner, 1, cart_comm, &reqs[b][1]);
+            B_step[b] = B_recv[b].data();
+            ++received;
+        }
+
+        // Our own blocks go to the ranks that need them at this step
+        int a_target = cart_rank(row, col - row - s);
+        if (!node_base[a_target])
+            MPI_Isend(A_local, block_len, MPI_DOUBLE, a_target, 0, cart_comm, &reqs[b][2]);
+        int b_target = cart_rank(row - col - s, col);
+        if (!node_base[b_target])
+            MPI_Isend(B_local, block_len, MPI_DOUBLE, b_target, 1, cart_comm, &reqs[b][3]);
+    };
+
+    start_step(0);
+    for (int s = 0; s < q; ++s) {
+        {
+            TRACE_SPAN("cannon_wait");
+            MPI_Waitall(4, reqs[s & 1], MPI_STATUSES_IGNORE);
+        }
+        if (s + 1 < q)
+            start_step(s + 1);
+        TRACE_SPAN("cannon_multiply");
+        multiply_block(A_step[s & 1], B_step[s & 1], C_block, block_size);
+    }
+    return received;
+}
+
+// Cannon with blocks moving over the torus: C_block += A B. A_block and
+// B_block are shifted in place and end up skewed.
+void cannon_shift(double* A_block, double* B_block, double* C_block, int block_size, int q,
+                  int row, int col, MPI_Comm cart_comm) {
+    // Initial alignment for Cannon's algorithm
+    int left, right, up, down;
+    MPI_Cart_shift(cart_comm, 1, -row, &right, &left);
+    MPI_Sendrecv_replace(A_block, block_size * block_size, MPI_DOUBLE,
+                         left, 0, right, 0, cart_comm, MPI_STATUS_IGNORE);
+
+    MPI_Cart_shift(cart_comm, 0, -col, &down, &up);
+    MPI_Sendrecv_replace(B_block, block_size * block_size, MPI_DOUBLE,
+                         up, 0, down, 0, cart_comm, MPI_STATUS_IGNORE);
+
+    // Perform Cannon's algorithm
+    for (int step = 0; step < q; ++step) {
+        // Local matrix multiplication
+        {
+            TRACE_SPAN("cannon_multiply");
+            multiply_block(A_block, B_block, C_block, block_size);
+        }
+
+        TRACE_SPAN("cannon_shift");
+        // Shift A left by one
+        MPI_Cart_shift(cart_comm, 1, -1, &right, &left);
+        MPI_Sendrecv_replace(A_block, block_size * block_size, MPI_DOUBLE,
+                             left, 0, right, 0, cart_comm, MPI_STATUS_IGNORE);
+
+        // Shift B up by one
+        MPI_Cart_shift(cart_comm, 0, -1, &down, &up);
+        MPI_Sendrecv_replace(B_block, block_size * block_size, MPI_DOUBLE,
+                             up, 0, down, 0, cart_comm, MPI_STATUS_IGNORE);
+    }
+}
+
+// C = A^k by repeated squaring with every matrix kept distributed over the
+// grid: A_block holds this rank's block of the running square, C_block that
+// of the result. Each product runs Cannon on copies of its operands (Cannon
+// shifts them away), and the copy, product and spare buffers are allocated
+// once for the whole chain. Returns the number of multiplications.
+int cannon_power(vector<double>& A_block, vector<double>& C_block, int k, int block_size, int q,
+                 int row, int col, MPI_Comm cart_comm) {
+    int block_len = block_size * block_size;
+    vector<double> X(block_len), Y(block_len), product(block_len);
+    int multiplications = 0;
+    auto multiply = [&](const vector<double>& lhs, const vector<double>& rhs) {
+        copy(lhs.begin(), lhs.end(), X.begin());
+        copy(rhs.begin(), rhs.end(), Y.begin());
+        fill(product.begin(), product.end(), 0.0);
+        cannon_shift(X.data(), Y.data(), product.data(), block_size, q, row, col, cart_comm);
+        ++multiplications;
+    };
+
+    bool have_result = false;
+    while (k > 0) {
+        if (k & 1) {
+            if (!have_result) {
+                C_block = A_block;
+                have_result = true;
+            }
+            else {
+                multiply(C_block, A_block);
+                C_block.swap(product);
+            }
+        }
+        k >>= 1;
+        if (k > 0) {
+            multiply(A_block, A_block);
+            A_block.swap(product);
+        }
+    }
+    return multiplications;
+}
+
 int main(int argc, char* argv[]) {
     MPI_Init(&argc, &argv);
 
+    string write_mode = get_option(argc, argv, "write", "collective");
+    string cb_nodes = get_option(argc, argv, "cb_nodes", "");
+    string cb_buffer_size = get_option(argc, argv, "cb_buffer_size", "");
+    string comm_mode = get_option(argc, argv, "comm", "shift");
+    // --power=k computes A^k instead of A B, keeping the blocks on the grid
+    // between the multiplications and writing only the final C. This is the
+    // only distributed A^k driver; Lab5 / Lab5B benchmark A B only
+    int power = stoi(get_option(argc, argv, "power", "0"));
+    if (power > 0) comm_mode = "shift";  // the shared-window variant only does A B
+
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
+    span_trace::init();
 
     // Determine the process grid dimensions
     int q = static_cast<int>(sqrt(size));
@@ -31,8 +231,12 @@ int main(int argc, char* argv[]) {
     MPI_Comm cart_comm;
     MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 1, &cart_comm);
 
+    // Reordering may give this process another rank in cart_comm; the
+    // coordinates and the file views must both use that one
+    int cart_rank;
+    MPI_Comm_rank(cart_comm, &cart_rank);
     int coords[2];
-    MPI_Cart_coords(cart_comm, rank, 2, coords);
+    MPI_Cart_coords(cart_comm, cart_rank, 2, coords);
     int row = coords[0];
     int col = coords[1];
 
@@ -75,121 +279,179 @@ int main(int argc, char* argv[]) {
     vector<double> B_block(block_size * block_size);
     vector<double> C_block(block_size * block_size, 0.0);
 
+    // With --comm=shm the A and B blocks live in a window shared by the ranks
+    // of one node, so node neighbours can read them without copying
+    double* A_local = A_block.data();
+    double* B_local = B_block.data();
+    MPI_Comm node_comm = MPI_COMM_NULL;
+    MPI_Win win = MPI_WIN_NULL;
+    if (comm_mode == "shm") {
+        MPI_Comm_split_type(cart_comm, MPI_COMM_TYPE_SHARED, cart_rank, MPI_INFO_NULL, &node_comm);
+        double* base;
+        MPI_Win_allocate_shared(2 * static_cast<MPI_Aint>(block_size) * block_size * sizeof(double), sizeof(double),
+                                MPI_INFO_NULL, node_comm, &base, &win);
+        A_local = base;
+        B_local = base + block_size * block_size;
+    }
+
+    // Hardware counters (MPP_PERF=1) cover rank 0's share of the work; with
+    // counters on, the barrier keeps its roofline measurement out of the other
+    // ranks' read time
+    PhaseProfiler perf(1, rank == 0);
+    mem_trace::MemoryTimeline mem(false);
+    if (PhaseProfiler::requested()) MPI_Barrier(cart_comm);
+
     // Start timing for reading
     auto read_start = steady_clock::now();
+    mem.begin();
 
     // Parallel reading of A and B blocks
     MPI_File file;
     MPI_Offset offset;
-    MPI_Datatype block_type;
-    MPI_Type_vector(block_size, block_size, M, MPI_DOUBLE, &block_type);
-    MPI_Type_create_resized(block_type, 0, sizeof(double), &block_type);
-    MPI_Type_commit(&block_type);
-
     int gsizes[2] = { M, M };
     int distribs[2] = { MPI_DISTRIBUTE_BLOCK, MPI_DISTRIBUTE_BLOCK };
     int dargs[2] = { MPI_DISTRIBUTE_DFLT_DARG, MPI_DISTRIBUTE_DFLT_DARG };
     int psizes[2] = { q, q };
 
     MPI_Datatype filetype;
-    MPI_Type_create_darray(size, rank, 2, gsizes, distribs, dargs, psizes,
+    MPI_Type_create_darray(size, cart_rank, 2, gsizes, distribs, dargs, psizes,
                            MPI_ORDER_C, MPI_DOUBLE, &filetype);
     MPI_Type_commit(&filetype);
+    MPI_Info io_info = block_io::collective_io_info(cb_nodes, cb_buffer_size);
 
     // Read A_block
-    MPI_File_open(cart_comm, a_filename, MPI_MODE_RDONLY, MPI_INFO_NULL, &file);
-    MPI_File_set_view(file, 0, MPI_DOUBLE, filetype, "native", MPI_INFO_NULL);
-    MPI_File_read_all(file, A_block.data(), block_size * block_size, MPI_DOUBLE, MPI_STATUS_IGNORE);
+    MPI_File_open(cart_comm, a_filename, MPI_MODE_RDONLY, io_info, &file);
+    MPI_File_set_view(file, 0, MPI_DOUBLE, filetype, "native", io_info);
+    MPI_File_read_all(file, A_local, block_size * block_size, MPI_DOUBLE, MPI_STATUS_IGNORE);
     MPI_File_close(&file);
 
-    // Read B_block
-    MPI_File_open(cart_comm, b_filename, MPI_MODE_RDONLY, MPI_INFO_NULL, &file);
-    MPI_File_set_view(file, 0, MPI_DOUBLE, filetype, "native", MPI_INFO_NULL);
-    MPI_File_read_all(file, B_block.data(), block_size * block_size, MPI_DOUBLE, MPI_STATUS_IGNORE);
-    MPI_File_close(&file);
+    // Read B_block (not needed for A^k)
+    if (power == 0) {
+        MPI_File_open(cart_comm, b_filename, MPI_MODE_RDONLY, io_info, &file);
+        MPI_File_set_view(file, 0, MPI_DOUBLE, filetype, "native", io_info);
+        MPI_File_read_all(file, B_local, block_size * block_size, MPI_DOUBLE, MPI_STATUS_IGNORE);
+        MPI_File_close(&file);
+    }
 
     auto read_end = steady_clock::now();
+    mem.end("Read");
     double read_time = duration<double, milli>(read_end - read_start).count();
+    MPI_Info_free(&io_info);
+
+    double read_time_max;
+    MPI_Reduce(&read_time, &read_time_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
 
     // Start timing for computation
     auto comp_start = steady_clock::now();
+    perf.begin();
+    mem.begin();
 
-    // Initial alignment for Cannon's algorithm
-    int left, right, up, down;
-    MPI_Cart_shift(cart_comm, 1, -row, &right, &left);
-    MPI_Sendrecv_replace(A_block.data(), block_size * block_size, MPI_DOUBLE,
-                         left, 0, right, 0, cart_comm, MPI_STATUS_IGNORE);
-
-    MPI_Cart_shift(cart_comm, 0, -col, &down, &up);
-    MPI_Sendrecv_replace(B_block.data(), block_size * block_size, MPI_DOUBLE,
-                         up, 0, down, 0, cart_comm, MPI_STATUS_IGNORE);
-
-    // Perform Cannon's algorithm
-    for (int step = 0; step < q; ++step) {
-        // Local matrix multiplication
-        for (int i = 0; i < block_size; ++i) {
-            for (int j = 0; j < block_size; ++j) {
-                double sum = 0.0;
-                for (int k = 0; k < block_size; ++k) {
-                    sum += A_block[i * block_size + k] * B_block[k * block_size + j];
-                }
-                C_block[i * block_size + j] += sum;
-            }
-        }
-
-        // Shift A left by one
-        MPI_Cart_shift(cart_comm, 1, -1, &right, &left);
-        MPI_Sendrecv_replace(A_block.data(), block_size * block_size, MPI_DOUBLE,
-                             left, 0, right, 0, cart_comm, MPI_STATUS_IGNORE);
-
-        // Shift B up by one
-        MPI_Cart_shift(cart_comm, 0, -1, &down, &up);
-        MPI_Sendrecv_replace(B_block.data(), block_size * block_size, MPI_DOUBLE,
-                             up, 0, down, 0, cart_comm, MPI_STATUS_IGNORE);
+    int remote_blocks = 0;
+    int multiplications = 1;
+    if (power > 0) {
+        multiplications = cannon_power(A_block, C_block, power, block_size, q, row, col, cart_comm);
+    }
+    else if (comm_mode == "shm") {
+        // Make the blocks read into the window visible to the whole node
+        MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+        MPI_Win_sync(win);
+        MPI_Barrier(node_comm);
+        MPI_Win_sync(win);
+        remote_blocks = cannon_shm(A_local, B_local, C_block.data(), block_size, q, row, col, cart_comm, node_comm, win);
+        MPI_Barrier(node_comm);
+        MPI_Win_unlock_all(win);
+    }
+    else {
+        cannon_shift(A_block.data(), B_block.data(), C_block.data(), block_size, q, row, col, cart_comm);
     }
 
     auto comp_end = steady_clock::now();
+    mem.end("Computation");
+    perf.end("Computation (rank 0)", 2.0 * block_size * block_size * M * multiplications,
+             (2.0 * q + 1) * block_size * block_size * sizeof(double) * multiplications);
     double comp_time = duration<double, milli>(comp_end - comp_start).count();
 
     // Start timing for writing
     auto write_start = steady_clock::now();
+    mem.begin();
 
-    // Gather C_blocks to rank 0
-    vector<double> C;
-    if (rank == 0) {
-        C.resize(M * M);
-    }
+    if (write_mode == "gather") {
+        // Gather C_blocks into the row-major matrix on rank 0 of the grid
+        vector<double> C;
+        if (cart_rank == 0) {
+            C.resize(M * M);
+        }
 
-    MPI_Gather(C_block.data(), block_size * block_size, MPI_DOUBLE,
-               C.data(), block_size * block_size, MPI_DOUBLE,
-               0, cart_comm);
+        block_io::gather_matrix(C_block.data(), C.data(), M, block_size, cart_comm);
 
-    // Rank 0 writes the result to the output file
-    if (rank == 0) {
-        ofstream output(c_filename, ios::out | ios::binary);
-        if (!output) {
+        // which writes the result to the output file
+        if (cart_rank == 0) {
+            ofstream output(c_filename, ios::out | ios::binary);
+            if (!output) {
+                cerr << "Cannot open output file." << endl;
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+            }
+            output.write(reinterpret_cast<char*>(C.data()), M * M * sizeof(double));
+            output.close();
+        }
+    }
+    else {
+        // Every rank writes its own C_block through the darray view used for reading
+        MPI_Info info = block_io::collective_io_info(cb_nodes, cb_buffer_size);
+        if (MPI_File_open(cart_comm, c_filename, MPI_MODE_CREATE | MPI_MODE_WRONLY, info, &file) != MPI_SUCCESS) {
             cerr << "Cannot open output file." << endl;
             MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
         }
-        output.write(reinterpret_cast<char*>(C.data()), M * M * sizeof(double));
-        output.close();
+        MPI_File_set_size(file, static_cast<MPI_Offset>(M) * M * sizeof(double));
+        MPI_File_set_view(file, 0, MPI_DOUBLE, filetype, "native", info);
+        MPI_File_write_all(file, C_block.data(), block_size * block_size, MPI_DOUBLE, MPI_STATUS_IGNORE);
+        MPI_File_close(&file);
+        MPI_Info_free(&info);
     }
 
     auto write_end = steady_clock::now();
+    mem.end("Write");
     double write_time = duration<double, milli>(write_end - write_start).count();
 
     // Output timing information
+    int remote_total = 0;
+    MPI_Reduce(&remote_blocks, &remote_total, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+
     double total_time = duration<double, milli>(write_end - read_start).count();
     if (rank == 0) {
         cout << "Read time: " << read_time << " ms" << endl;
+        // B is not read for A^k
+        double read_bytes = (power > 0 ? 1.0 : 2.0) * M * M * sizeof(double);
+        cout << "Read bandwidth: " << read_bytes / 1e6 / (read_time_max / 1000.0) << " MB/s (aggregate)" << endl;
+        if (power > 0)
+            cout << "A^" << power << " with " << multiplications << " multiplications" << endl;
         cout << "Computation time: " << comp_time << " ms" << endl;
+        if (comm_mode == "shm")
+            cout << "Blocks sent between nodes: " << remote_total << " of " << 2 * q * size << endl;
         cout << "Write time: " << write_time << " ms" << endl;
         cout << "Total execution time: " << total_time << " ms" << endl;
     }
+    mem.report(MPI_COMM_WORLD);
+
+    if (span_trace::enabled()) {
+        // Cannon's steps are lock-step, so uneven compute across ranks turns into shift / wait time
+        double busy = span_trace::busy_ms("cannon_multiply");
+        vector<double> all_busy(size);
+        MPI_Gather(&busy, 1, MPI_DOUBLE, all_busy.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        span_trace::finish(rank);
+        if (rank == 0) {
+            double max_busy = *max_element(all_busy.begin(), all_busy.end()), mean_busy = 0.0;
+            for (double b : all_busy) mean_busy += b / size;
+            cout << "Rank compute imbalance (max / mean): " << max_busy / mean_busy << endl;
+        }
+    }
 
     // Clean up
-    MPI_Type_free(&block_type);
     MPI_Type_free(&filetype);
+    if (win != MPI_WIN_NULL) {
+        MPI_Win_free(&win);
+        MPI_Comm_free(&node_comm);
+    }
     MPI_Comm_free(&cart_comm);
     MPI_Finalize();
     return 0;
@@ -0,0 +1,262 @@
+#include <mpi.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+using namespace std::chrono;
+
+const string INPUT_FILE_NAME = "input.txt";
+
+int M;
+string FileA, FileB, FileC;
+
+struct Panel {
+    int k, width;
+    int a_owner, b_owner; // grid column holding A(:, k..), grid row holding B(k.., :)
+};
+
+string get_option(int argc, char* argv[], const string& name, const string& def) {
+    string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0)
+            return arg.substr(prefix.size());
+    }
+    return def;
+}
+
+void read_input() {
+    ifstream rf(INPUT_FILE_NAME);
+    if (!rf.is_open()) {
+        cerr << "Cannot open input file!" << endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    rf >> M >> FileA >> FileB >> FileC;
+}
+
+// Parses "RxC" into two positive grid dimensions; anything else is rejected.
+bool parse_grid(const string& grid, int dims[2]) {
+    size_t x = grid.find('x');
+    if (x == string::npos || x == 0 || x + 1 == grid.size())
+        return false;
+    try {
+        size_t end_r, end_c;
+        dims[0] = stoi(grid.substr(0, x), &end_r);
+        dims[1] = stoi(grid.substr(x + 1), &end_c);
+        if (end_r != x || end_c != grid.size() - x - 1)
+            return false;
+    }
+    catch (...) { return false; }
+    return dims[0] > 0 && dims[1] > 0;
+}
+
+// Uneven block distribution of n indices over p parts: the first n % p parts
+// get one extra index, so any M works on any grid.
+int part_size(int n, int p, int i) {
+    return n / p + (i < n % p ? 1 : 0);
+}
+
+int part_start(int n, int p, int i) {
+    return i * (n / p) + min(i, n % p);
+}
+
+int part_owner(int n, int p, int idx) {
+    int base = n / p, big = n % p;
+    if (idx < big * (base + 1))
+        return idx / (base + 1);
+    return big + (idx - big * (base + 1)) / base;
+}
+
+MPI_Datatype block_filetype(int rows, int cols, int row0, int col0) {
+    int sizes[2] = { M, M };
+    int subsizes[2] = { rows, cols };
+    int starts[2] = { row0, col0 };
+    MPI_Datatype filetype;
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_DOUBLE, &filetype);
+    MPI_Type_commit(&filetype);
+    return filetype;
+}
+
+void read_block(double* block, const string& fileName, int rows, int cols, int row0, int col0, MPI_Comm comm) {
+    MPI_Datatype filetype = block_filetype(rows, cols, row0, col0);
+    MPI_File file;
+    if (MPI_File_open(comm, fileName.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        cerr << "Cannot open matrix file " << fileName << endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_set_view(file, 0, MPI_DOUBLE, filetype, "native", MPI_INFO_NULL);
+    MPI_File_read_all(file, block, rows * cols, MPI_DOUBLE, MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+    MPI_Type_free(&filetype);
+}
+
+void write_block(const double* block, const string& fileName, int rows, int cols, int row0, int col0, MPI_Comm comm) {
+    MPI_Datatype filetype = block_filetype(rows, cols, row0, col0);
+    MPI_File file;
+    if (MPI_File_open(comm, fileName.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        cerr << "Cannot open output file " << fileName << endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_set_size(file, static_cast<MPI_Offset>(M) * M * sizeof(double));
+    MPI_File_set_view(file, 0, MPI_DOUBLE, filetype, "native", MPI_INFO_NULL);
+    MPI_File_write_all(file, block, rows * cols, MPI_DOUBLE, MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+    MPI_Type_free(&filetype);
+}
+
+// C (rows x cols) += A_panel (rows x width) * B_panel (width x cols)
+void multiply_panel(const double* A, const double* B, double* C, int rows, int cols, int width) {
+    for (int i = 0; i < rows; ++i) {
+        double* c = C + static_cast<size_t>(i) * cols;
+        for (int k = 0; k < width; ++k) {
+            double a = A[i * width + k];
+            const double* b = B + static_cast<size_t>(k) * cols;
+            for (int j = 0; j < cols; ++j)
+                c[j] += a * b[j];
+        }
+    }
+}
+
+// Panels never straddle an owner boundary of A's columns or B's rows, so each
+// one has a single root in its row and column broadcast.
+vector<Panel> plan_panels(int Pr, int Pc, int nb) {
+    vector<Panel> panels;
+    for (int k = 0; k < M;) {
+        int a_owner = part_owner(M, Pc, k);
+        int b_owner = part_owner(M, Pr, k);
+        int a_end = part_start(M, Pc, a_owner) + part_size(M, Pc, a_owner);
+        int b_end = part_start(M, Pr, b_owner) + part_size(M, Pr, b_owner);
+        int width = min({ nb, a_end - k, b_end - k });
+        panels.push_back({ k, width, a_owner, b_owner });
+        k += width;
+    }
+    return panels;
+}
+
+int main(int argc, char* argv[]) {
+    MPI_Init(&argc, &argv);
+
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // Any Pr x Pc grid: taken from --grid=RxC or chosen by MPI_Dims_create
+    int dims[2] = { 0, 0 };
+    string grid = get_option(argc, argv, "grid", "");
+    if (grid.empty()) {
+        MPI_Dims_create(size, 2, dims);
+    }
+    else if (!parse_grid(grid, dims)) {
+        if (rank == 0) cerr << "Invalid --grid=" << grid << ", expected RxC with positive R and C." << endl;
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+    else if (static_cast<long long>(dims[0]) * dims[1] != size) {
+        if (rank == 0) cerr << "Grid " << dims[0] << "x" << dims[1] << " does not match " << size << " processes." << endl;
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+    int Pr = dims[0], Pc = dims[1];
+    int nb = 0;
+    try { nb = stoi(get_option(argc, argv, "nb", "64")); } catch (...) {}
+    if (nb < 1) {
+        if (rank == 0) {
+            cerr << "Invalid --nb=" << get_option(argc, argv, "nb", "") << ", expected a positive panel width." << endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    int periods[2] = { 0, 0 };
+    MPI_Comm grid_comm;
+    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 1, &grid_comm);
+    int grid_rank, coords[2];
+    MPI_Comm_rank(grid_comm, &grid_rank);
+    MPI_Cart_coords(grid_comm, grid_rank, 2, coords);
+    int row = coords[0], col = coords[1];
+
+    MPI_Comm row_comm, col_comm;
+    MPI_Comm_split(grid_comm, row, col, &row_comm);
+    MPI_Comm_split(grid_comm, col, row, &col_comm);
+
+    read_input();
+    if (M < Pr || M < Pc) {
+        if (rank == 0) cerr << "Matrix size M must be at least the grid size." << endl;
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+
+    int rows = part_size(M, Pr, row), row0 = part_start(M, Pr, row);
+    int cols = part_size(M, Pc, col), col0 = part_start(M, Pc, col);
+
+    vector<double> A_block(static_cast<size_t>(rows) * cols);
+    vector<double> B_block(static_cast<size_t>(rows) * cols);
+    vector<double> C_block(static_cast<size_t>(rows) * cols, 0.0);
+
+    auto read_start = steady_clock::now();
+    read_block(A_block.data(), FileA, rows, cols, row0, col0, grid_comm);
+    read_block(B_block.data(), FileB, rows, cols, row0, col0, grid_comm);
+    auto read_end = steady_clock::now();
+    double read_time = duration<double, milli>(read_end - read_start).count();
+
+    auto comp_start = steady_clock::now();
+
+    vector<Panel> panels = plan_panels(Pr, Pc, nb);
+    vector<double> A_panel[2] = { vector<double>(static_cast<size_t>(rows) * nb), vector<double>(static_cast<size_t>(rows) * nb) };
+    vector<double> B_panel[2] = { vector<double>(static_cast<size_t>(nb) * cols), vector<double>(static_cast<size_t>(nb) * cols) };
+    MPI_Request reqs[2][2];
+
+    // Owners pack panel p into buffer p % 2 and start both broadcasts, so the
+    // next panel is in flight while the current one is multiplied.
+    auto start_panel = [&](size_t p) {
+        const Panel& pn = panels[p];
+        double* Ap = A_panel[p & 1].data();
+        double* Bp = B_panel[p & 1].data();
+        if (col == pn.a_owner) {
+            int kc = pn.k - col0;
+            for (int i = 0; i < rows; ++i)
+                copy(&A_block[static_cast<size_t>(i) * cols + kc], &A_block[static_cast<size_t>(i) * cols + kc + pn.width], Ap + i * pn.width);
+        }
+        if (row == pn.b_owner) {
+            int kr = pn.k - row0;
+            copy(&B_block[static_cast<size_t>(kr) * cols], &B_block[static_cast<size_t>(kr + pn.width) * cols], Bp);
+        }
+        MPI_Ibcast(Ap, rows * pn.width, MPI_DOUBLE, pn.a_owner, row_comm, &reqs[p & 1][0]);
+        MPI_Ibcast(Bp, pn.width * cols, MPI_DOUBLE, pn.b_owner, col_comm, &reqs[p & 1][1]);
+    };
+
+    start_panel(0);
+    for (size_t p = 0; p < panels.size(); ++p) {
+        MPI_Waitall(2, reqs[p & 1], MPI_STATUSES_IGNORE);
+        if (p + 1 < panels.size())
+            start_panel(p + 1);
+        multiply_panel(A_panel[p & 1].data(), B_panel[p & 1].data(), C_block.data(), rows, cols, panels[p].width);
+    }
+
+    auto comp_end = steady_clock::now();
+    double comp_time = duration<double, milli>(comp_end - comp_start).count();
+
+    auto write_start = steady_clock::now();
+    write_block(C_block.data(), FileC, rows, cols, row0, col0, grid_comm);
+    auto write_end = steady_clock::now();
+    double write_time = duration<double, milli>(write_end - write_start).count();
+
+    double total_time = duration<double, milli>(write_end - read_start).count();
+    if (rank == 0) {
+        cout << "Matrix size: " << M << " Grid: " << Pr << "x" << Pc << " Panel width: " << nb << endl;
+        cout << "Read time: " << read_time << " ms" << endl;
+        cout << "Computation time: " << comp_time << " ms" << endl;
+        cout << "Write time: " << write_time << " ms" << endl;
+        cout << "Total execution time: " << total_time << " ms" << endl;
+    }
+
+    MPI_Comm_free(&row_comm);
+    MPI_Comm_free(&col_comm);
+    MPI_Comm_free(&grid_comm);
+    MPI_Finalize();
+    return 0;
+}
@@ -5,6 +5,11 @@
 #include <cmath>
 #include <vector>
 #include <chrono>
+#include <string>
+#include <algorithm>
+#include "../Tools/mem_trace.h"
+#include "../Tools/block_io.h"
+#include "../Tools/perf_counters.h"
 
 using namespace std;
 
@@ -41,6 +46,22 @@ void write_matrix_bin(double* mat, const string& filename, int M) {
     out.close();
 }
 
+string get_option(int argc, char** argv, const string& name, const string& def) {
+    string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0)
+            return arg.substr(prefix.size());
+    }
+    return def;
+}
+
+bool has_flag(int argc, char** argv, const string& name) {
+    for (int i = 1; i < argc; ++i)
+        if (argv[i] == "--" + name) return true;
+    return false;
+}
+
 void multiply_block(double* A, double* B, double* C, int block_size) {
     #pragma omp parallel for num_threads(num_threads)
     for (int i = 0; i < block_size; i++) {
@@ -52,51 +73,102 @@ void multiply_block(double* A, double* B, double* C, int block_size) {
     }
 }
 
-void shift_left(double* block, int block_size, int steps, MPI_Comm row_comm) {
-    MPI_Status status;
-    int block_len = block_size * block_size;
-    vector<double> temp(block_len);
-    int rank, size;
-    MPI_Comm_rank(row_comm, &rank);
-    MPI_Comm_size(row_comm, &size);
-
-    int left = (rank - steps + size) % size;
-    int right = (rank + steps) % size;
-
-    MPI_Sendrecv(block, block_len, MPI_DOUBLE, left, 0,
-                 temp.data(), block_len, MPI_DOUBLE, right, 0, row_comm, &status);
-    copy(temp.begin(), temp.end(), block);
+// C rows [i0, i1) += A rows [i0, i1) * B, same loop order as multiply_block.
+void multiply_rows(const double* A, const double* B, double* C, int block_size, int i0, int i1) {
+    for (int i = i0; i < i1; i++) {
+        for (int j = 0; j < block_size; j++) {
+            double sum = C[i * block_size + j];
+            for (int k = 0; k < block_size; k++)
+                sum += A[i * block_size + k] * B[k * block_size + j];
+            C[i * block_size + j] = sum;
+        }
+    }
 }
 
-void shift_up(double* block, int block_size, int steps, MPI_Comm col_comm) {
-    MPI_Status status;
-    int block_len = block_size * block_size;
-    vector<double> temp(block_len);
-    int rank, size;
-    MPI_Comm_rank(col_comm, &rank);
-    MPI_Comm_size(col_comm, &size);
+// One parallel region for the whole Cannon loop. The master thread (the only
+// one calling MPI, so MPI_THREAD_FUNNELED is enough) starts the next shift,
+// then takes row chunks like the others and polls the requests between chunks
+// to keep them progressing. Returns the time the master spent waiting for
+// shifts that were not finished by the end of the step.
+double cannon_overlap(block_io::ShiftChannel& A_shift, block_io::ShiftChannel& B_shift, double* C_block, int block_size, int q) {
+    const int chunk = 4;
+    int next_row = 0;
+    double t_wait = 0.0;
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+        bool master = omp_get_thread_num() == 0;
+        for (int step = 0; step < q; ++step) {
+            const double* A = block_io::current(A_shift);
+            const double* B = block_io::current(B_shift);
+            bool more = step + 1 < q;
+            if (master && more) {
+                block_io::start_shift(A_shift);
+                block_io::start_shift(B_shift);
+            }
 
-    int up = (rank - steps + size) % size;
-    int down = (rank + steps) % size;
+            while (true) {
+                int i0;
+                #pragma omp atomic capture
+                { i0 = next_row; next_row += chunk; }
+                if (i0 >= block_size) break;
+                multiply_rows(A, B, C_block, block_size, i0, min(i0 + chunk, block_size));
+                if (master && more) {
+                    block_io::poll_shift(A_shift);
+                    block_io::poll_shift(B_shift);
+                }
+            }
 
-    MPI_Sendrecv(block, block_len, MPI_DOUBLE, up, 0,
-                 temp.data(), block_len, MPI_DOUBLE, down, 0, col_comm, &status);
-    copy(temp.begin(), temp.end(), block);
+            #pragma omp barrier
+            if (master) {
+                if (more) {
+                    double t0 = MPI_Wtime();
+                    block_io::finish_shift(A_shift);
+                    block_io::finish_shift(B_shift);
+                    t_wait += MPI_Wtime() - t0;
+                }
+                next_row = 0;
+            }
+            #pragma omp barrier
+        }
+    }
+    return t_wait;
 }
 
 int main(int argc, char** argv) {
     if (argc < 2) {
-        cerr << "Usage: mpirun -np <P> ./program <num_threads>\n";
+        cerr << "Usage: mpirun -np <P> ./program <num_threads> [--overlap] [--dist=mpiio|stream|scatter] [--write=collective|gather] [--cb_nodes=N] [--cb_buffer_size=B]\n"
+             << "Both --write modes produce the same row-major file; gather assembles it on one rank first.\n";
         return 1;
     }
 
     num_threads = atoi(argv[1]);
-
-    MPI_Init(&argc, &argv);
+    string write_mode = get_option(argc, argv, "write", "collective");
+    string dist = get_option(argc, argv, "dist", "mpiio");
+    string cb_nodes = get_option(argc, argv, "cb_nodes", "");
+    string cb_buffer_size = get_option(argc, argv, "cb_buffer_size", "");
+    bool overlap = has_flag(argc, argv, "overlap");
+
+    if (overlap) {
+        int provided;
+        MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+        if (provided < MPI_THREAD_FUNNELED) {
+            cerr << "MPI library does not support MPI_THREAD_FUNNELED\n";
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    else {
+        MPI_Init(&argc, &argv);
+    }
     int world_rank, world_size;
     MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
     MPI_Comm_size(MPI_COMM_WORLD, &world_size);
 
+    // Hardware counters (MPP_PERF=1) cover rank 0's share of the multiply; with
+    // counters on, the barrier keeps its roofline measurement out of the timings
+    PhaseProfiler perf(num_threads, world_rank == 0);
+    if (PhaseProfiler::requested()) MPI_Barrier(MPI_COMM_WORLD);
+
     auto t_start = chrono::steady_clock::now();
 
     read_input("input.txt");
@@ -113,76 +185,128 @@ int main(int argc, char** argv) {
     double* B_block = new double[block_size * block_size]{};
     double* C_block = new double[block_size * block_size]{};
 
-    double* A_full = nullptr;
-    double* B_full = nullptr;
-    double* C_full = nullptr;
+    MPI_Comm cart_comm, row_comm, col_comm;
+    int dims[2] = {q, q}, periods[2] = {1, 1}, coords[2];
+    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 1, &cart_comm);
+    // Reordering may give this process another rank in cart_comm
+    int cart_rank;
+    MPI_Comm_rank(cart_comm, &cart_rank);
+    MPI_Cart_coords(cart_comm, cart_rank, 2, coords);
+
+    MPI_Comm_split(cart_comm, coords[0], coords[1], &row_comm);
+    MPI_Comm_split(cart_comm, coords[1], coords[0], &col_comm);
 
+    mem_trace::MemoryTimeline mem(false);
     auto r_start = chrono::steady_clock::now();
-    if (world_rank == 0) {
-        A_full = new double[M * M];
-        B_full = new double[M * M];
-        C_full = new double[M * M]{};
+    mem.begin();
+    if (dist == "scatter") {
+        // Legacy path: one rank holds both full matrices and scatters the blocks
+        double* A_full = nullptr;
+        double* B_full = nullptr;
+        if (cart_rank == 0) {
+            A_full = new double[M * M];
+            B_full = new double[M * M];
+
+            read_matrix_bin(A_full, FileA, M);
+            read_matrix_bin(B_full, FileB, M);
+        }
 
-        read_matrix_bin(A_full, FileA, M);
-        read_matrix_bin(B_full, FileB, M);
-    }
+        block_io::scatter_matrix(A_full, A_block, M, block_size, cart_comm);
+        block_io::scatter_matrix(B_full, B_block, M, block_size, cart_comm);
 
-    MPI_Scatter(A_full, block_size * block_size, MPI_DOUBLE, A_block,
-                block_size * block_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-    MPI_Scatter(B_full, block_size * block_size, MPI_DOUBLE, B_block,
-                block_size * block_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        delete[] A_full;
+        delete[] B_full;
+    }
+    else if (dist == "stream") {
+        block_io::read_block_stream(A_block, FileA, M, block_size, q, cart_comm);
+        block_io::read_block_stream(B_block, FileB, M, block_size, q, cart_comm);
+    }
+    else {
+        block_io::read_block(A_block, FileA, M, block_size, coords[0], coords[1], cart_comm);
+        block_io::read_block(B_block, FileB, M, block_size, coords[0], coords[1], cart_comm);
+    }
 
     auto r_end = chrono::steady_clock::now();
+    mem.end("Read");
     double t_read = chrono::duration<double, milli>(r_end - r_start).count();
 
     auto m_start = chrono::steady_clock::now();
+    perf.begin();
+    mem.begin();
 
-    MPI_Comm cart_comm, row_comm, col_comm;
-    int dims[2] = {q, q}, periods[2] = {1, 1}, coords[2];
-    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 1, &cart_comm);
-    MPI_Cart_coords(cart_comm, world_rank, 2, coords);
-
-    MPI_Comm_split(cart_comm, coords[0], coords[1], &row_comm);
-    MPI_Comm_split(cart_comm, coords[1], coords[0], &col_comm);
-
-    shift_left(A_block, block_size, coords[0], row_comm);
-    shift_up(B_block, block_size, coords[1], col_comm);
-
-    for (int step = 0; step < q; ++step) {
-        multiply_block(A_block, B_block, C_block, block_size);
-        shift_left(A_block, block_size, 1, row_comm);
-        shift_up(B_block, block_size, 1, col_comm);
+    int block_len = block_size * block_size;
+    double* A_spare = new double[block_len];
+    double* B_spare = new double[block_len];
+    block_io::ShiftChannel A_shift, B_shift;
+    block_io::init_shift(A_shift, A_block, A_spare, block_len, coords[0], row_comm);
+    block_io::init_shift(B_shift, B_block, B_spare, block_len, coords[1], col_comm);
+
+    double t_wait = 0.0;
+    if (overlap) {
+        t_wait = cannon_overlap(A_shift, B_shift, C_block, block_size, q);
     }
+    else {
+        for (int step = 0; step < q; ++step) {
+            multiply_block(block_io::current(A_shift), block_io::current(B_shift), C_block, block_size);
+            if (step + 1 < q) {
+                block_io::shift(A_shift);
+                block_io::shift(B_shift);
+            }
+        }
+    }
+    block_io::free_shift(A_shift);
+    block_io::free_shift(B_shift);
 
     auto m_end = chrono::steady_clock::now();
+    perf.end("Multiplication (rank 0)", 2.0 * block_size * block_size * M,
+             (2.0 * q + 1) * block_size * block_size * sizeof(double));
+    mem.end("Multiplication");
     double t_mult = chrono::duration<double, milli>(m_end - m_start).count();
+    double t_wait_max;
+    MPI_Reduce(&t_wait, &t_wait_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
 
+    double* C_full = nullptr;
     auto w_start = chrono::steady_clock::now();
-    MPI_Gather(C_block, block_size * block_size, MPI_DOUBLE, C_full,
-               block_size * block_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    mem.begin();
+    if (write_mode == "gather") {
+        if (cart_rank == 0) {
+            C_full = new double[M * M]();
+            block_io::gather_matrix(C_block, C_full, M, block_size, cart_comm);
+            write_matrix_bin(C_full, FileC, M);
+        }
+        else {
+            block_io::gather_matrix(C_block, nullptr, M, block_size, cart_comm);
+        }
+    }
+    else {
+        MPI_Info info = block_io::collective_io_info(cb_nodes, cb_buffer_size);
+        block_io::write_block(C_block, FileC, M, block_size, coords[0], coords[1], cart_comm, info);
+        MPI_Info_free(&info);
+    }
     auto w_end = chrono::steady_clock::now();
+    mem.end("Write");
     double t_write = chrono::duration<double, milli>(w_end - w_start).count();
 
     auto t_end = chrono::steady_clock::now();
     double t_total = chrono::duration<double, milli>(t_end - t_start).count();
 
     if (world_rank == 0) {
-        write_matrix_bin(C_full, FileC, M);
         cout << "Matrix size: " << M << " Threads per process: " << num_threads << endl;
         cout << "Read time: " << t_read << " ms\n";
         cout << "Multiplication time: " << t_mult << " ms\n";
+        if (overlap)
+            cout << "Exposed shift wait: " << t_wait_max * 1000.0 << " ms\n";
         cout << "Write time: " << t_write << " ms\n";
         cout << "Total time: " << t_total << " ms\n";
     }
+    mem.report(MPI_COMM_WORLD);
 
     delete[] A_block;
     delete[] B_block;
     delete[] C_block;
-    if (world_rank == 0) {
-        delete[] A_full;
-        delete[] B_full;
-        delete[] C_full;
-    }
+    delete[] A_spare;
+    delete[] B_spare;
+    delete[] C_full;
 
     MPI_Finalize();
     return 0;
@@ -5,6 +5,10 @@
 #include <cmath>
 #include <vector>
 #include <chrono>
+#include <string>
+#include "../Tools/mem_trace.h"
+#include "../Tools/block_io.h"
+#include "../Tools/perf_counters.h"
 
 using namespace std;
 
@@ -21,22 +25,6 @@ void read_input(string inputFile) {
     in.close();
 }
 
-void read_matrix_block(double* mat_block, const string& filename, int M, int block_size, int row_block, int col_block) {
-    ifstream in(filename, ios::binary);
-    if (!in.is_open()) {
-        cerr << "Cannot open file " << filename << endl;
-        MPI_Abort(MPI_COMM_WORLD, 1);
-    }
-
-    for (int i = 0; i < block_size; ++i) {
-        int row_index = row_block * block_size + i;
-        in.seekg((row_index * M + col_block * block_size) * sizeof(double), ios::beg);
-        in.read(reinterpret_cast<char*>(&mat_block[i * block_size]), sizeof(double) * block_size);
-    }
-
-    in.close();
-}
-
 void write_matrix_bin(double* mat, const string& filename, int M) {
     ofstream out(filename, ios::binary);
     if (!out.is_open()) {
@@ -47,6 +35,16 @@ void write_matrix_bin(double* mat, const string& filename, int M) {
     out.close();
 }
 
+string get_option(int argc, char** argv, const string& name, const string& def) {
+    string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0)
+            return arg.substr(prefix.size());
+    }
+    return def;
+}
+
 void multiply_block(double* A, double* B, double* C, int block_size) {
     #pragma omp parallel for num_threads(num_threads)
     for (int i = 0; i < block_size; i++) {
@@ -58,51 +56,28 @@ void multiply_block(double* A, double* B, double* C, int block_size) {
     }
 }
 
-void shift_left(double* block, int block_size, int steps, MPI_Comm row_comm) {
-    MPI_Status status;
-    int block_len = block_size * block_size;
-    vector<double> temp(block_len);
-    int rank, size;
-    MPI_Comm_rank(row_comm, &rank);
-    MPI_Comm_size(row_comm, &size);
-
-    int left = (rank - steps + size) % size;
-    int right = (rank + steps) % size;
-
-    MPI_Sendrecv(block, block_len, MPI_DOUBLE, left, 0,
-                 temp.data(), block_len, MPI_DOUBLE, right, 0, row_comm, &status);
-    copy(temp.begin(), temp.end(), block);
-}
-
-void shift_up(double* block, int block_size, int steps, MPI_Comm col_comm) {
-    MPI_Status status;
-    int block_len = block_size * block_size;
-    vector<double> temp(block_len);
-    int rank, size;
-    MPI_Comm_rank(col_comm, &rank);
-    MPI_Comm_size(col_comm, &size);
-
-    int up = (rank - steps + size) % size;
-    int down = (rank + steps) % size;
-
-    MPI_Sendrecv(block, block_len, MPI_DOUBLE, up, 0,
-                 temp.data(), block_len, MPI_DOUBLE, down, 0, col_comm, &status);
-    copy(temp.begin(), temp.end(), block);
-}
-
 int main(int argc, char** argv) {
     if (argc < 2) {
-        cerr << "Usage: mpirun -np <P> ./program <num_threads>\n";
+        cerr << "Usage: mpirun -np <P> ./program <num_threads> [--write=collective|gather] [--cb_nodes=N] [--cb_buffer_size=B]\n"
+             << "Both --write modes produce the same row-major file; gather assembles it on one rank first.\n";
         return 1;
     }
 
     num_threads = atoi(argv[1]);
+    string write_mode = get_option(argc, argv, "write", "collective");
+    string cb_nodes = get_option(argc, argv, "cb_nodes", "");
+    string cb_buffer_size = get_option(argc, argv, "cb_buffer_size", "");
 
     MPI_Init(&argc, &argv);
     int world_rank, world_size;
     MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
     MPI_Comm_size(MPI_COMM_WORLD, &world_size);
 
+    // Hardware counters (MPP_PERF=1) cover rank 0's share of the multiply; with
+    // counters on, the barrier keeps its roofline measurement out of the timings
+    PhaseProfiler perf(num_threads, world_rank == 0);
+    if (PhaseProfiler::requested()) MPI_Barrier(MPI_COMM_WORLD);
+
     auto t_start = chrono::steady_clock::now();
 
     read_input("input.txt");
@@ -120,7 +95,10 @@ int main(int argc, char** argv) {
     MPI_Comm cart_comm, row_comm, col_comm;
 
     MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 1, &cart_comm);
-    MPI_Cart_coords(cart_comm, world_rank, 2, coords);
+    // Reordering may give this process another rank in cart_comm
+    int cart_rank;
+    MPI_Comm_rank(cart_comm, &cart_rank);
+    MPI_Cart_coords(cart_comm, cart_rank, 2, coords);
 
     int row_block = coords[0];
     int col_block = coords[1];
@@ -132,51 +110,86 @@ int main(int argc, char** argv) {
     double* B_block = new double[block_size * block_size]();
     double* C_block = new double[block_size * block_size]();
 
+    mem_trace::MemoryTimeline mem(false);
+    MPI_Info io_info = block_io::collective_io_info(cb_nodes, cb_buffer_size);
     auto r_start = chrono::steady_clock::now();
-    read_matrix_block(A_block, FileA, M, block_size, row_block, col_block);
-    read_matrix_block(B_block, FileB, M, block_size, row_block, col_block);
+    mem.begin();
+    block_io::read_block(A_block, FileA, M, block_size, row_block, col_block, cart_comm, io_info);
+    block_io::read_block(B_block, FileB, M, block_size, row_block, col_block, cart_comm, io_info);
     auto r_end = chrono::steady_clock::now();
+    mem.end("Read");
     double t_read = chrono::duration<double, milli>(r_end - r_start).count();
+    MPI_Info_free(&io_info);
+
+    double t_read_max;
+    MPI_Reduce(&t_read, &t_read_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
 
     auto m_start = chrono::steady_clock::now();
-    shift_left(A_block, block_size, row_block, row_comm);
-    shift_up(B_block, block_size, col_block, col_comm);
+    perf.begin();
+    mem.begin();
+    int block_len = block_size * block_size;
+    double* A_spare = new double[block_len];
+    double* B_spare = new double[block_len];
+    block_io::ShiftChannel A_shift, B_shift;
+    block_io::init_shift(A_shift, A_block, A_spare, block_len, row_block, row_comm);
+    block_io::init_shift(B_shift, B_block, B_spare, block_len, col_block, col_comm);
 
     for (int step = 0; step < q; ++step) {
-        multiply_block(A_block, B_block, C_block, block_size);
-        shift_left(A_block, block_size, 1, row_comm);
-        shift_up(B_block, block_size, 1, col_comm);
+        multiply_block(block_io::current(A_shift), block_io::current(B_shift), C_block, block_size);
+        if (step + 1 < q) {
+            block_io::shift(A_shift);
+            block_io::shift(B_shift);
+        }
     }
+    block_io::free_shift(A_shift);
+    block_io::free_shift(B_shift);
     auto m_end = chrono::steady_clock::now();
+    mem.end("Multiplication");
+    perf.end("Multiplication (rank 0)", 2.0 * block_size * block_size * M,
+             (2.0 * q + 1) * block_size * block_size * sizeof(double));
     double t_mult = chrono::duration<double, milli>(m_end - m_start).count();
 
     double* C_full = nullptr;
-    if (world_rank == 0)
-        C_full = new double[M * M]();
-
     auto w_start = chrono::steady_clock::now();
-    MPI_Gather(C_block, block_size * block_size, MPI_DOUBLE, C_full,
-               block_size * block_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    mem.begin();
+    if (write_mode == "gather") {
+        if (cart_rank == 0) {
+            C_full = new double[M * M]();
+            block_io::gather_matrix(C_block, C_full, M, block_size, cart_comm);
+            write_matrix_bin(C_full, FileC, M);
+        }
+        else {
+            block_io::gather_matrix(C_block, nullptr, M, block_size, cart_comm);
+        }
+    }
+    else {
+        MPI_Info info = block_io::collective_io_info(cb_nodes, cb_buffer_size);
+        block_io::write_block(C_block, FileC, M, block_size, row_block, col_block, cart_comm, info);
+        MPI_Info_free(&info);
+    }
     auto w_end = chrono::steady_clock::now();
+    mem.end("Write");
     double t_write = chrono::duration<double, milli>(w_end - w_start).count();
 
     auto t_end = chrono::steady_clock::now();
     double t_total = chrono::duration<double, milli>(t_end - t_start).count();
 
     if (world_rank == 0) {
-        write_matrix_bin(C_full, FileC, M);
         cout << "Matrix size: " << M << " Threads per process: " << num_threads << endl;
         cout << "Read time: " << t_read << " ms\n";
+        cout << "Read bandwidth: " << 2.0 * M * M * sizeof(double) / 1e6 / (t_read_max / 1000.0) << " MB/s (aggregate)\n";
         cout << "Multiplication time: " << t_mult << " ms\n";
         cout << "Write time: " << t_write << " ms\n";
         cout << "Total time: " << t_total << " ms\n";
     }
+    mem.report(MPI_COMM_WORLD);
 
     delete[] A_block;
     delete[] B_block;
     delete[] C_block;
-    if (world_rank == 0)
-        delete[] C_full;
+    delete[] A_spare;
+    delete[] B_spare;
+    delete[] C_full;
 
     MPI_Finalize();
     return 0;
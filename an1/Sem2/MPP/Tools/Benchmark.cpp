@@ -0,0 +1,262 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <cctype>
+#include <sys/stat.h>
+
+using namespace std;
+
+const string INPUT_FILE_NAME = "input.txt";
+
+// One line of the plan file: "name counts command". Every count n is
+// substituted for {n} in the command; a count written n:p uses p processors
+// for efficiency and cost (e.g. ranks x threads for hybrid runs), else p = n.
+struct Variant {
+    string name, command;
+    vector<pair<int, int>> counts;
+};
+
+struct Sample {
+    double t_read = NAN, t_mult = NAN, t_write = NAN, t_total = NAN;
+};
+
+string get_option(int argc, char* argv[], const string& name, const string& def) {
+    string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0)
+            return arg.substr(prefix.size());
+    }
+    return def;
+}
+
+vector<string> split(const string& s, char sep) {
+    vector<string> parts;
+    stringstream ss(s);
+    string part;
+    while (getline(ss, part, sep))
+        if (!part.empty()) parts.push_back(part);
+    return parts;
+}
+
+vector<Variant> read_plan(const string& fileName) {
+    ifstream rf(fileName);
+    if (!rf.is_open()) {
+        cerr << "Cannot open plan file " << fileName << endl;
+        exit(2);
+    }
+    vector<Variant> plan;
+    string line;
+    while (getline(rf, line)) {
+        istringstream in(line);
+        Variant v;
+        string counts;
+        if (!(in >> v.name >> counts) || v.name[0] == '#') continue;
+        getline(in, v.command);
+        v.command.erase(0, v.command.find_first_not_of(" \t"));
+        for (const string& c : split(counts, ',')) {
+            size_t colon = c.find(':');
+            int n = stoi(c.substr(0, colon));
+            v.counts.push_back({ n, colon == string::npos ? n : stoi(c.substr(colon + 1)) });
+        }
+        plan.push_back(v);
+    }
+    return plan;
+}
+
+// Same value range as Lab1's generator, but seeded so runs are repeatable.
+void generate_matrix(const string& fileName, uint32_t M, mt19937_64& rng) {
+    uniform_real_distribution<double> dist(0.0, 10.0);
+    ofstream wf(fileName, ios::out | ios::binary);
+    vector<double> row(M);
+    for (uint32_t i = 0; i < M; ++i) {
+        for (auto& x : row) x = dist(rng);
+        wf.write(reinterpret_cast<const char*>(row.data()), sizeof(double) * M);
+    }
+}
+
+bool file_exists(const string& fileName) {
+    struct stat st;
+    return stat(fileName.c_str(), &st) == 0;
+}
+
+// Phase of a timing line, by whole word so that e.g. "thread" is not "read".
+// "... FOR READ = x ms" names the phase after FOR; otherwise the label in front
+// of ':' or '=' is searched ("Reading Time", "Matrix multiplication time").
+double* phase_of(Sample& s, const string& lower) {
+    string label = lower.substr(0, lower.find_first_of(":="));
+    for (char& c : label)
+        if (!isalnum(static_cast<unsigned char>(c))) c = ' ';
+    vector<string> words = split(label, ' ');
+    auto for_it = find(words.rbegin(), words.rend(), "for");
+    if (for_it != words.rend())
+        words.erase(words.begin(), for_it.base());
+
+    for (const string& w : words) {
+        if (w == "total") return &s.t_total;
+        if (w == "read" || w == "reading") return &s.t_read;
+        if (w == "write" || w == "writing") return &s.t_write;
+        if (w == "computation" || w == "multiplication") return &s.t_mult;
+    }
+    return nullptr;
+}
+
+// Picks the phase times out of a driver's output. The drivers word them
+// differently ("Read time: x ms", "... FOR READ = x ms", "Matrix multiplication
+// time", "Writing Time", "Total time", ...), so lines ending in "ms" are
+// classified by phase_of and the number in front of "ms" is taken.
+Sample parse_output(const string& output) {
+    Sample s;
+    istringstream in(output);
+    string line;
+    while (getline(in, line)) {
+        string lower = line;
+        transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        vector<string> words = split(lower, ' ');
+        auto ms = find(words.begin(), words.end(), "ms");
+        if (ms == words.begin() || ms == words.end() || ms + 1 != words.end()) continue;
+        double value;
+        try { value = stod(*(ms - 1)); }
+        catch (...) { continue; }
+
+        double* target = phase_of(s, lower);
+        if (target && std::isnan(*target)) *target = value;
+    }
+    return s;
+}
+
+bool run(const string& command, Sample& s) {
+    FILE* p = popen((command + " 2>&1").c_str(), "r");
+    if (!p) return false;
+    string output;
+    char buf[4096];
+    while (fgets(buf, sizeof(buf), p))
+        output += buf;
+    int status = pclose(p);
+    s = parse_output(output);
+    if (status != 0) {
+        cerr << "Run failed: " << command << "\n" << output;
+        return false;
+    }
+    if (std::isnan(s.t_read) || std::isnan(s.t_mult) || std::isnan(s.t_write) || std::isnan(s.t_total)) {
+        cerr << "Run failed: no read / multiply / write / total time in the output of " << command << "\n" << output;
+        return false;
+    }
+    return true;
+}
+
+// Median of the values that are not NaN (NaN if there are none).
+double median(vector<double> v) {
+    v.erase(remove_if(v.begin(), v.end(), [](double x) { return std::isnan(x); }), v.end());
+    if (v.empty()) return NAN;
+    sort(v.begin(), v.end());
+    size_t n = v.size();
+    return n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+// Two-sided 95% Student t quantile for n - 1 degrees of freedom.
+double t95(size_t n) {
+    static const double table[] = { 0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+                                    2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086 };
+    size_t df = n - 1;
+    return df < sizeof(table) / sizeof(table[0]) ? table[df] : 1.96;
+}
+
+// 95% confidence interval of the mean.
+pair<double, double> ci95(const vector<double>& v) {
+    size_t n = v.size();
+    double mean = 0.0, var = 0.0;
+    for (double x : v) mean += x;
+    mean /= n;
+    if (n < 2) return { mean, mean };
+    for (double x : v) var += (x - mean) * (x - mean);
+    var /= n - 1;
+    double half = t95(n) * sqrt(var / n);
+    return { mean - half, mean + half };
+}
+
+string substitute(string command, int n) {
+    for (size_t pos; (pos = command.find("{n}")) != string::npos;)
+        command.replace(pos, 3, to_string(n));
+    return command;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argv[1][0] == '-') {
+        cerr << "Usage: " << argv[0] << " plan.txt [--sizes=500,1000] [--warmup=1] [--iterations=5]"
+             << " [--out=benchmark.csv] [--seed=1]" << endl;
+        return 2;
+    }
+    vector<Variant> plan = read_plan(argv[1]);
+    vector<string> sizes = split(get_option(argc, argv, "sizes", "1000"), ',');
+    int warmup = stoi(get_option(argc, argv, "warmup", "1"));
+    int iterations = stoi(get_option(argc, argv, "iterations", "5"));
+    string out_file = get_option(argc, argv, "out", "benchmark.csv");
+    // Strip the extension of the file name only, so "../bench" keeps its directory
+    size_t slash = out_file.rfind('/'), dot = out_file.rfind('.');
+    if (dot == string::npos || (slash != string::npos && dot < slash)) dot = out_file.size();
+    string summary_file = out_file.substr(0, dot) + "_summary.csv";
+    mt19937_64 rng(stoull(get_option(argc, argv, "seed", "1")));
+
+    ofstream raw(out_file), summary(summary_file);
+    raw << "Variant,M,Nr Threds,iteration,T_reading,T_multiplication,T_writing,T_total\n";
+    summary << "Variant,M,Nr Threds,n,runs,T_reading,T_multiplication,T_writing,T_total,"
+               "T_total_ci95_low,T_total_ci95_high,Speed-Up,Efficiency,Cost\n";
+
+    for (const string& size : sizes) {
+        uint32_t M = stoul(size);
+        string fileA = "A_" + size + ".bin", fileB = "B_" + size + ".bin", fileC = "C_" + size + ".bin";
+        if (!file_exists(fileA)) generate_matrix(fileA, M, rng);
+        if (!file_exists(fileB)) generate_matrix(fileB, M, rng);
+        ofstream(INPUT_FILE_NAME) << M << " " << fileA << " " << fileB << " " << fileC << endl;
+
+        // The first plan entry is the baseline for speed-up (normally the sequential driver)
+        double t_baseline = NAN;
+        for (const Variant& v : plan) {
+            for (const auto& count : v.counts) {
+                string command = substitute(v.command, count.first);
+                // Nr Threds is the number of processing units, so a hybrid
+                // n:p run is compared with thread runs by p (as in scaling)
+                int procs = count.second;
+                cout << "M=" << M << " " << v.name << " n=" << count.first << ": " << command << endl;
+
+                Sample s;
+                for (int w = 0; w < warmup; ++w)
+                    run(command, s);
+
+                vector<double> reads, mults, writes, totals;
+                for (int it = 1; it <= iterations; ++it) {
+                    if (!run(command, s)) continue;
+                    raw << v.name << "," << M << "," << procs << "," << it << "," << s.t_read << ","
+                        << s.t_mult << "," << s.t_write << "," << s.t_total << "\n";
+                    reads.push_back(s.t_read);
+                    mults.push_back(s.t_mult);
+                    writes.push_back(s.t_write);
+                    totals.push_back(s.t_total);
+                }
+                raw.flush();
+                if (totals.empty()) continue;
+
+                double t_total = median(totals);
+                pair<double, double> ci = ci95(totals);
+                if (std::isnan(t_baseline)) t_baseline = t_total;
+                double speedup = t_baseline / t_total;
+                summary << v.name << "," << M << "," << procs << "," << count.first << "," << totals.size() << ","
+                        << median(reads) << "," << median(mults) << "," << median(writes) << "," << t_total << ","
+                        << ci.first << "," << ci.second << "," << speedup << ","
+                        << speedup / procs << "," << procs * t_total << "\n";
+                summary.flush();
+                cout << "  T_total median " << t_total << " ms (95% CI of mean " << ci.first << " - " << ci.second << "), speed-up " << speedup << endl;
+            }
+        }
+    }
+
+    cout << "Results: " << out_file << ", " << summary_file << endl;
+    return 0;
+}
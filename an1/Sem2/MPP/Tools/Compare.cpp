@@ -0,0 +1,145 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <omp.h>
+#include "matrix_file.h"
+
+using namespace std;
+using namespace std::chrono;
+
+string get_option(int argc, char* argv[], const string& name, const string& def) {
+    string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0)
+            return arg.substr(prefix.size());
+    }
+    return def;
+}
+
+// Maps a double onto a monotonically ordered integer line so that the
+// difference of two mapped values is their distance in ULPs.
+inline int64_t ordered_bits(double x) {
+    int64_t i;
+    memcpy(&i, &x, sizeof(i));
+    return i < 0 ? INT64_MIN - i : i;
+}
+
+// NaN never passes a tolerance test, so it is decided on the bits alone: a NaN
+// against a number, or two NaNs with different payloads, is a difference.
+// Written as !(err <= bound) so an infinity against a finite value (where
+// tol * scale is NaN for tol = 0) also counts.
+inline bool differs(double x, double y, double tol) {
+    if (isnan(x) || isnan(y))
+        return ordered_bits(x) != ordered_bits(y);
+    return ordered_bits(x) != ordered_bits(y) && !(fabs(x - y) <= tol * fmax(fabs(x), fabs(y)));
+}
+
+struct Tile {
+    uint32_t row, col;
+};
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <fileX.bin> <fileY.bin> [--tol=0] [--tile=64] [--tiles=10]\n";
+        return 2;
+    }
+
+    double tol = stod(get_option(argc, argv, "tol", "0"));
+    uint32_t tile = stoul(get_option(argc, argv, "tile", "64"));
+    size_t max_tiles = stoul(get_option(argc, argv, "tiles", "10"));
+    if (tile == 0) {
+        cerr << "--tile must be at least 1\n";
+        return 2;
+    }
+
+    auto t_start = steady_clock::now();
+
+    MappedMatrix X, Y;
+    if (!map_matrix(argv[1], X) || !map_matrix(argv[2], Y))
+        return 2;
+    if (X.M != Y.M) {
+        cerr << "Size mismatch: " << X.M << " vs " << Y.M << endl;
+        return 2;
+    }
+
+    uint32_t M = X.M;
+    uint32_t bands = (M + tile - 1) / tile;
+    uint32_t tile_cols = bands;
+
+    double max_abs = 0.0, max_rel = 0.0;
+    uint64_t max_ulp = 0, differing = 0;
+    vector<vector<uint32_t>> band_tiles(bands);
+
+    // Each band of `tile` rows is compared with a vectorised reduction; only
+    // rows that contain a difference are rescanned to locate their tiles.
+#pragma omp parallel for schedule(dynamic) reduction(max:max_abs, max_rel, max_ulp) reduction(+:differing)
+    for (uint32_t band = 0; band < bands; ++band) {
+        vector<char> marked(tile_cols, 0);
+        uint32_t row_end = min(M, (band + 1) * tile);
+
+        for (uint32_t i = band * tile; i < row_end; ++i) {
+            const double* x = X.data + static_cast<size_t>(i) * M;
+            const double* y = Y.data + static_cast<size_t>(i) * M;
+            uint64_t row_diff = 0;
+
+#pragma omp simd reduction(max:max_abs, max_rel, max_ulp) reduction(+:row_diff)
+            for (uint32_t j = 0; j < M; ++j) {
+                row_diff += differs(x[j], y[j], tol) ? 1 : 0;
+                // NaNs are counted above but kept out of the error statistics
+                if (isnan(x[j]) || isnan(y[j])) continue;
+                double abs_err = fabs(x[j] - y[j]);
+                double scale = fmax(fabs(x[j]), fabs(y[j]));
+                double rel_err = scale > 0.0 ? abs_err / scale : 0.0;
+                int64_t a = ordered_bits(x[j]), b = ordered_bits(y[j]);
+                uint64_t ulp = a > b ? static_cast<uint64_t>(a) - static_cast<uint64_t>(b)
+                                     : static_cast<uint64_t>(b) - static_cast<uint64_t>(a);
+                max_abs = fmax(max_abs, abs_err);
+                max_rel = fmax(max_rel, rel_err);
+                max_ulp = max(max_ulp, ulp);
+            }
+
+            if (row_diff == 0) continue;
+            differing += row_diff;
+            for (uint32_t j = 0; j < M; ++j)
+                if (differs(x[j], y[j], tol))
+                    marked[j / tile] = 1;
+        }
+
+        for (uint32_t c = 0; c < tile_cols && band_tiles[band].size() < max_tiles; ++c)
+            if (marked[c]) band_tiles[band].push_back(c);
+    }
+
+    vector<Tile> first_tiles;
+    for (uint32_t band = 0; band < bands && first_tiles.size() < max_tiles; ++band)
+        for (uint32_t c : band_tiles[band]) {
+            if (first_tiles.size() == max_tiles) break;
+            first_tiles.push_back({ band, c });
+        }
+
+    auto t_end = steady_clock::now();
+    double t_ms = duration<double, milli>(t_end - t_start).count();
+    double gb = 2.0 * X.bytes / 1e9;
+
+    cout << "Matrix size: " << M << " Threads: " << omp_get_max_threads() << endl;
+    cout << "Max absolute error: " << max_abs << endl;
+    cout << "Max relative error: " << max_rel << endl;
+    cout << "Max ULP distance: " << max_ulp << endl;
+    cout << "Differing elements: " << differing << " (tol " << tol << ")" << endl;
+    if (!first_tiles.empty()) {
+        cout << "First differing tiles (" << tile << "x" << tile << ", row,col):";
+        for (const Tile& t : first_tiles)
+            cout << " (" << t.row << "," << t.col << ")";
+        cout << endl;
+    }
+    cout << "Compare time: " << t_ms << " ms (" << gb / (t_ms / 1000.0) << " GB/s)" << endl;
+
+    unmap_matrix(X);
+    unmap_matrix(Y);
+    return differing == 0 ? 0 : 1;
+}
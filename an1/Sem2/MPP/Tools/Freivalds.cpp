@@ -0,0 +1,143 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <cmath>
+#include <cfloat>
+#include <chrono>
+#include <omp.h>
+#include "matrix_file.h"
+
+using namespace std;
+using namespace std::chrono;
+
+const string INPUT_FILE_NAME = "input.txt";
+
+string get_option(int argc, char* argv[], const string& name, const string& def) {
+    string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0)
+            return arg.substr(prefix.size());
+    }
+    return def;
+}
+
+// Y = Mat X and Yabs = |Mat| Xabs for k right-hand sides at once (X is M x k,
+// row-major), so every matrix is streamed from the mapping exactly once.
+void multiply_panel(const double* mat, uint32_t M, const double* X, const double* Xabs,
+                    double* Y, double* Yabs, int k) {
+#pragma omp parallel for schedule(static)
+    for (uint32_t i = 0; i < M; ++i) {
+        const double* row = mat + static_cast<size_t>(i) * M;
+        double* y = Y + static_cast<size_t>(i) * k;
+        double* yabs = Yabs + static_cast<size_t>(i) * k;
+        for (int r = 0; r < k; ++r) y[r] = yabs[r] = 0.0;
+        for (uint32_t j = 0; j < M; ++j) {
+            double a = row[j], a_abs = fabs(row[j]);
+            const double* x = X + static_cast<size_t>(j) * k;
+            const double* xabs = Xabs + static_cast<size_t>(j) * k;
+#pragma omp simd
+            for (int r = 0; r < k; ++r) {
+                y[r] += a * x[r];
+                yabs[r] += a_abs * xabs[r];
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    string fileA, fileB, fileC;
+    int positional = 0;
+    for (int i = 1; i < argc; ++i)
+        if (string(argv[i]).compare(0, 2, "--") != 0) {
+            string* target[3] = { &fileA, &fileB, &fileC };
+            if (positional < 3) *target[positional] = argv[i];
+            ++positional;
+        }
+    if (positional == 0) {
+        ifstream rf(INPUT_FILE_NAME);
+        uint32_t M_in;
+        if (!(rf >> M_in >> fileA >> fileB >> fileC)) {
+            cerr << "Usage: " << argv[0] << " [A.bin B.bin C.bin] [--p=1e-9] [--tol=16] [--seed=N]\n"
+                 << "Without files the names are taken from " << INPUT_FILE_NAME << endl;
+            return 2;
+        }
+    }
+    else if (positional != 3) {
+        cerr << "Usage: " << argv[0] << " [A.bin B.bin C.bin] [--p=1e-9] [--tol=16] [--seed=N]\n";
+        return 2;
+    }
+
+    // Each {0,1} vector lets a wrong C through with probability <= 1/2,
+    // so k vectors bound the false acceptance probability by 2^-k.
+    double p = stod(get_option(argc, argv, "p", "1e-9"));
+    double tol = stod(get_option(argc, argv, "tol", "16"));
+    if (!(p > 0.0 && p < 1.0)) {
+        cerr << "--p must be in (0, 1), got " << p << endl;
+        return 2;
+    }
+    int k = max(1, static_cast<int>(ceil(log2(1.0 / p))));
+    uint64_t seed = stoull(get_option(argc, argv, "seed", to_string(random_device{}())));
+
+    auto t_start = steady_clock::now();
+
+    MappedMatrix A, B, C;
+    if (!map_matrix(fileA, A) || !map_matrix(fileB, B) || !map_matrix(fileC, C))
+        return 2;
+    if (A.M != B.M || A.M != C.M) {
+        cerr << "Size mismatch: " << A.M << ", " << B.M << ", " << C.M << endl;
+        return 2;
+    }
+    uint32_t M = A.M;
+
+    vector<double> X(static_cast<size_t>(M) * k);
+    mt19937_64 gen(seed);
+    for (double& x : X) x = static_cast<double>(gen() & 1);
+
+    vector<double> Y(X.size()), Z(X.size()), W(X.size());
+    vector<double> Yabs(X.size()), Zabs(X.size()), Wabs(X.size());
+
+    // A (B X) against C X, plus |A| (|B| X) and |C| X as the rounding error scale.
+    multiply_panel(B.data, M, X.data(), X.data(), Y.data(), Yabs.data(), k);
+    multiply_panel(A.data, M, Y.data(), Yabs.data(), Z.data(), Zabs.data(), k);
+    multiply_panel(C.data, M, X.data(), X.data(), W.data(), Wabs.data(), k);
+
+    double bound_scale = tol * M * DBL_EPSILON;
+    int64_t first_bad_row = -1;
+    double max_ratio = 0.0;
+#pragma omp parallel for reduction(max:max_ratio)
+    for (uint32_t i = 0; i < M; ++i) {
+        for (int r = 0; r < k; ++r) {
+            size_t idx = static_cast<size_t>(i) * k + r;
+            double bound = bound_scale * (Zabs[idx] + Wabs[idx]);
+            double err = fabs(Z[idx] - W[idx]);
+            double ratio = bound > 0.0 ? err / bound : (err > 0.0 ? INFINITY : 0.0);
+            // A NaN in the data makes err or bound NaN, which must fail too
+            if (isnan(err) || isnan(bound)) ratio = INFINITY;
+            max_ratio = max(max_ratio, ratio);
+            if (!(ratio <= 1.0)) {
+#pragma omp critical
+                if (first_bad_row < 0 || i < first_bad_row) first_bad_row = i;
+            }
+        }
+    }
+
+    auto t_end = steady_clock::now();
+    double t_ms = duration<double, milli>(t_end - t_start).count();
+
+    cout << "Matrix size: " << M << " Threads: " << omp_get_max_threads() << endl;
+    cout << "Random vectors: " << k << " (false acceptance <= 2^-" << k << " = " << ldexp(1.0, -k) << "), seed " << seed << endl;
+    cout << "Max error / bound: " << max_ratio << " (tol " << tol << " * M * eps)" << endl;
+    if (first_bad_row >= 0)
+        cout << "Verification FAILED, first mismatching row: " << first_bad_row << " (replay with --seed=" << seed << ")" << endl;
+    else
+        cout << "Verification passed" << endl;
+    cout << "Verify time: " << t_ms << " ms (" << 3.0 * A.bytes / 1e9 / (t_ms / 1000.0) << " GB/s)" << endl;
+
+    unmap_matrix(A);
+    unmap_matrix(B);
+    unmap_matrix(C);
+    return first_bad_row >= 0 ? 1 : 0;
+}
@@ -0,0 +1,256 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <omp.h>
+#include "matrix_file.h"
+#include "content_hash.h"
+
+using namespace std;
+using namespace std::chrono;
+
+const string INPUT_FILE_NAME = "input.txt";
+const uint32_t STATE_MAGIC = 0x4D505049; // "IPPM"
+
+uint32_t M;
+string FileA, FileB, FileC;
+
+// Per-panel hashes of the inputs C was last computed from. The previous B is
+// kept next to C because the rank-k correction needs B_new - B_old.
+struct PanelState {
+    uint32_t M = 0, panel_rows = 0;
+    vector<uint64_t> hashA, hashB;
+};
+
+string get_option(int argc, char* argv[], const string& name, const string& def) {
+    string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0)
+            return arg.substr(prefix.size());
+    }
+    return def;
+}
+
+bool has_flag(int argc, char* argv[], const string& name) {
+    for (int i = 1; i < argc; ++i)
+        if (argv[i] == "--" + name) return true;
+    return false;
+}
+
+void read_input() {
+    ifstream rf(INPUT_FILE_NAME);
+    if (!rf.is_open()) {
+        cerr << "Cannot open input file!" << endl;
+        exit(1);
+    }
+    rf >> M >> FileA >> FileB >> FileC;
+}
+
+void write_matrix_binary(const double* mat, uint32_t M, const string& fileName) {
+    ofstream wf(fileName, ios::out | ios::binary);
+    if (!wf.is_open()) {
+        cerr << "Cannot open output file " << fileName << endl;
+        exit(1);
+    }
+    wf.write(reinterpret_cast<const char*>(mat), sizeof(double) * M * M);
+}
+
+bool load_state(const string& fileName, PanelState& st) {
+    ifstream rf(fileName, ios::binary);
+    uint32_t magic = 0, panels = 0;
+    if (!rf.read(reinterpret_cast<char*>(&magic), sizeof(magic)) || magic != STATE_MAGIC)
+        return false;
+    rf.read(reinterpret_cast<char*>(&st.M), sizeof(st.M));
+    rf.read(reinterpret_cast<char*>(&st.panel_rows), sizeof(st.panel_rows));
+    rf.read(reinterpret_cast<char*>(&panels), sizeof(panels));
+    st.hashA.resize(panels);
+    st.hashB.resize(panels);
+    rf.read(reinterpret_cast<char*>(st.hashA.data()), panels * sizeof(uint64_t));
+    rf.read(reinterpret_cast<char*>(st.hashB.data()), panels * sizeof(uint64_t));
+    return static_cast<bool>(rf);
+}
+
+void save_state(const string& fileName, const PanelState& st) {
+    ofstream wf(fileName, ios::binary);
+    uint32_t panels = st.hashA.size();
+    wf.write(reinterpret_cast<const char*>(&STATE_MAGIC), sizeof(STATE_MAGIC));
+    wf.write(reinterpret_cast<const char*>(&st.M), sizeof(st.M));
+    wf.write(reinterpret_cast<const char*>(&st.panel_rows), sizeof(st.panel_rows));
+    wf.write(reinterpret_cast<const char*>(&panels), sizeof(panels));
+    wf.write(reinterpret_cast<const char*>(st.hashA.data()), panels * sizeof(uint64_t));
+    wf.write(reinterpret_cast<const char*>(st.hashB.data()), panels * sizeof(uint64_t));
+}
+
+vector<uint64_t> panel_hashes(const double* mat, uint32_t M, uint32_t panel_rows) {
+    uint32_t panels = (M + panel_rows - 1) / panel_rows;
+    vector<uint64_t> hashes(panels);
+#pragma omp parallel for schedule(dynamic)
+    for (uint32_t p = 0; p < panels; ++p) {
+        uint32_t rows = min(panel_rows, M - p * panel_rows);
+        hashes[p] = content_hash::hash_bytes(mat + static_cast<size_t>(p) * panel_rows * M,
+                                             static_cast<size_t>(rows) * M * sizeof(double), p);
+    }
+    return hashes;
+}
+
+// C[i, :] = A[i, :] B for the listed rows.
+void multiply_rows(const double* A, const double* B, double* C, uint32_t M, const vector<uint32_t>& rows) {
+#pragma omp parallel for schedule(dynamic)
+    for (size_t r = 0; r < rows.size(); ++r) {
+        uint32_t i = rows[r];
+        double* c = C + static_cast<size_t>(i) * M;
+        fill(c, c + M, 0.0);
+        for (uint32_t k = 0; k < M; ++k) {
+            double a = A[static_cast<size_t>(i) * M + k];
+            const double* b = B + static_cast<size_t>(k) * M;
+            for (uint32_t j = 0; j < M; ++j)
+                c[j] += a * b[j];
+        }
+    }
+}
+
+// C[i, :] += A[i, K] (B_new[K, :] - B_old[K, :]) for every row i not marked
+// for recomputation, where K are the rows of the changed B panels.
+void rank_k_update(const double* A, const double* B, const double* B_old, double* C, uint32_t M,
+                   const vector<uint32_t>& k_rows, const vector<char>& recomputed) {
+    vector<double> dB(k_rows.size() * static_cast<size_t>(M));
+#pragma omp parallel for
+    for (size_t r = 0; r < k_rows.size(); ++r)
+        for (uint32_t j = 0; j < M; ++j) {
+            size_t idx = static_cast<size_t>(k_rows[r]) * M + j;
+            dB[r * M + j] = B[idx] - B_old[idx];
+        }
+
+#pragma omp parallel for schedule(static)
+    for (uint32_t i = 0; i < M; ++i) {
+        if (recomputed[i]) continue;
+        double* c = C + static_cast<size_t>(i) * M;
+        for (size_t r = 0; r < k_rows.size(); ++r) {
+            double a = A[static_cast<size_t>(i) * M + k_rows[r]];
+            const double* d = dB.data() + r * M;
+            for (uint32_t j = 0; j < M; ++j)
+                c[j] += a * d[j];
+        }
+    }
+}
+
+vector<uint32_t> panel_rows_of(const vector<uint32_t>& panels, uint32_t panel_rows, uint32_t M) {
+    vector<uint32_t> rows;
+    for (uint32_t p : panels)
+        for (uint32_t i = p * panel_rows; i < min(M, (p + 1) * panel_rows); ++i)
+            rows.push_back(i);
+    return rows;
+}
+
+int main(int argc, char* argv[]) {
+    int num_threads = stoi(get_option(argc, argv, "threads", to_string(omp_get_max_threads())));
+    uint32_t panel_rows = stoul(get_option(argc, argv, "panel", "64"));
+    bool force_full = has_flag(argc, argv, "full");
+    if (panel_rows < 1) {
+        cerr << "--panel must be at least 1 row" << endl;
+        return 1;
+    }
+    omp_set_num_threads(num_threads);
+
+    read_input();
+    cout << "Matrix size: " << M << " Nr of threads: " << num_threads << " Panel rows: " << panel_rows << endl;
+
+    string state_file = FileC + ".state";
+    string prevB_file = FileC + ".prevB";
+
+    auto t_start = steady_clock::now();
+
+    MappedMatrix A, B;
+    if (!map_matrix(FileA, A) || !map_matrix(FileB, B))
+        return 1;
+    if (A.M != M || B.M != M) {
+        cerr << "Input files do not hold " << M << " x " << M << " matrices" << endl;
+        return 1;
+    }
+
+    auto h_start = steady_clock::now();
+    PanelState current;
+    current.M = M;
+    current.panel_rows = panel_rows;
+    current.hashA = panel_hashes(A.data, M, panel_rows);
+    current.hashB = panel_hashes(B.data, M, panel_rows);
+    auto h_end = steady_clock::now();
+    cout << "Hash time: " << duration<double, milli>(h_end - h_start).count() << " ms" << endl;
+
+    PanelState previous;
+    MappedMatrix C, B_old;
+    bool incremental = !force_full && load_state(state_file, previous)
+        && previous.M == M && previous.panel_rows == panel_rows
+        && map_matrix(FileC, C, true) && map_matrix(prevB_file, B_old, true)
+        && C.M == M && B_old.M == M;
+
+    if (!incremental) {
+        if (C.data) unmap_matrix(C);
+        if (B_old.data) unmap_matrix(B_old);
+        cout << "Full recomputation" << endl;
+
+        vector<uint32_t> all_rows(M);
+        for (uint32_t i = 0; i < M; ++i) all_rows[i] = i;
+        vector<double> C_full(static_cast<size_t>(M) * M);
+
+        auto m_start = steady_clock::now();
+        multiply_rows(A.data, B.data, C_full.data(), M, all_rows);
+        auto m_end = steady_clock::now();
+        cout << "Matrix multiplication time: " << duration<double, milli>(m_end - m_start).count() << " ms" << endl;
+
+        auto w_start = steady_clock::now();
+        write_matrix_binary(C_full.data(), M, FileC);
+        write_matrix_binary(B.data, M, prevB_file);
+        save_state(state_file, current);
+        auto w_end = steady_clock::now();
+        cout << "Write time: " << duration<double, milli>(w_end - w_start).count() << " ms" << endl;
+    }
+    else {
+        vector<uint32_t> changedA, changedB;
+        for (uint32_t p = 0; p < current.hashA.size(); ++p) {
+            if (current.hashA[p] != previous.hashA[p]) changedA.push_back(p);
+            if (current.hashB[p] != previous.hashB[p]) changedB.push_back(p);
+        }
+        cout << "Changed panels: A " << changedA.size() << ", B " << changedB.size()
+             << " of " << current.hashA.size() << endl;
+
+        vector<uint32_t> a_rows = panel_rows_of(changedA, panel_rows, M);
+        vector<uint32_t> k_rows = panel_rows_of(changedB, panel_rows, M);
+        vector<char> recomputed(M, 0);
+        for (uint32_t i : a_rows) recomputed[i] = 1;
+
+        auto m_start = steady_clock::now();
+        if (!k_rows.empty())
+            rank_k_update(A.data, B.data, B_old.data, C.data, M, k_rows, recomputed);
+        if (!a_rows.empty())
+            multiply_rows(A.data, B.data, C.data, M, a_rows);
+        auto m_end = steady_clock::now();
+        double work = (static_cast<double>(a_rows.size()) * M + static_cast<double>(M - a_rows.size()) * k_rows.size())
+                      / (static_cast<double>(M) * M);
+        cout << "Matrix multiplication time: " << duration<double, milli>(m_end - m_start).count()
+             << " ms (" << 100.0 * work << "% of a full multiply)" << endl;
+
+        auto w_start = steady_clock::now();
+        for (uint32_t k : k_rows)
+            copy(B.data + static_cast<size_t>(k) * M, B.data + static_cast<size_t>(k + 1) * M,
+                 B_old.data + static_cast<size_t>(k) * M);
+        msync(C.data, C.bytes, MS_SYNC);
+        msync(B_old.data, B_old.bytes, MS_SYNC);
+        save_state(state_file, current);
+        auto w_end = steady_clock::now();
+        cout << "Write time: " << duration<double, milli>(w_end - w_start).count() << " ms" << endl;
+
+        unmap_matrix(C);
+        unmap_matrix(B_old);
+    }
+
+    auto t_end = steady_clock::now();
+    cout << "Total execution time: " << duration<double, milli>(t_end - t_start).count() << " ms" << endl;
+
+    unmap_matrix(A);
+    unmap_matrix(B);
+    return 0;
+}
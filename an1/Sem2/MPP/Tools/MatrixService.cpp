@@ -0,0 +1,349 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <cstring>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "matrix_file.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// A matrix held by the service in POSIX shared memory (/dev/shm/mpp_<name>),
+// in the raw .bin layout, so clients can map the result instead of reading a file.
+struct SharedMatrix {
+    string shm_name;
+    double* data = nullptr;
+    size_t bytes = 0;
+    uint32_t M = 0;
+};
+
+string get_option(int argc, char* argv[], const string& name, const string& def) {
+    string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0)
+            return arg.substr(prefix.size());
+    }
+    return def;
+}
+
+// Threads are started once and parked between jobs; the calling thread works
+// too. Rows are handed out one at a time through an atomic counter.
+class WorkerPool {
+public:
+    explicit WorkerPool(int n) {
+        for (int t = 1; t < n; ++t)
+            workers.emplace_back([this] { worker_loop(); });
+    }
+
+    ~WorkerPool() {
+        {
+            lock_guard<mutex> lk(m);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto& t : workers) t.join();
+    }
+
+    int size() const { return static_cast<int>(workers.size()) + 1; }
+
+    void parallel_rows(uint32_t rows, const function<void(uint32_t)>& body) {
+        {
+            lock_guard<mutex> lk(m);
+            job = &body;
+            job_rows = rows;
+            next_row = 0;
+            active = static_cast<int>(workers.size());
+            ++generation;
+        }
+        wake.notify_all();
+        work();
+        unique_lock<mutex> lk(m);
+        done.wait(lk, [this] { return active == 0; });
+    }
+
+private:
+    void work() {
+        for (uint32_t i; (i = next_row.fetch_add(1)) < job_rows;)
+            (*job)(i);
+    }
+
+    void worker_loop() {
+        uint64_t seen = 0;
+        while (true) {
+            {
+                unique_lock<mutex> lk(m);
+                wake.wait(lk, [&] { return stop || generation != seen; });
+                if (stop) return;
+                seen = generation;
+            }
+            work();
+            lock_guard<mutex> lk(m);
+            if (--active == 0) done.notify_one();
+        }
+    }
+
+    vector<thread> workers;
+    mutex m;
+    condition_variable wake, done;
+    const function<void(uint32_t)>* job = nullptr;
+    uint32_t job_rows = 0;
+    atomic<uint32_t> next_row{ 0 };
+    int active = 0;
+    uint64_t generation = 0;
+    bool stop = false;
+};
+
+map<string, SharedMatrix> matrices;
+
+bool valid_name(const string& name) {
+    return !name.empty() && all_of(name.begin(), name.end(), [](char c) { return isalnum(static_cast<unsigned char>(c)) || c == '_'; });
+}
+
+void release_shared(SharedMatrix& mat) {
+    if (mat.data) munmap(mat.data, mat.bytes);
+    shm_unlink(mat.shm_name.c_str());
+    mat = SharedMatrix{};
+}
+
+// Returns the named matrix sized M x M, keeping the existing segment (and its
+// warm pages) when the size has not changed.
+SharedMatrix* ensure_matrix(const string& name, uint32_t M) {
+    auto it = matrices.find(name);
+    if (it != matrices.end()) {
+        if (it->second.M == M) return &it->second;
+        release_shared(it->second);
+        matrices.erase(it);
+    }
+
+    SharedMatrix mat;
+    mat.shm_name = "/mpp_" + name;
+    mat.M = M;
+    mat.bytes = static_cast<size_t>(M) * M * sizeof(double);
+    int fd = shm_open(mat.shm_name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0 || ftruncate(fd, mat.bytes) != 0) {
+        if (fd >= 0) close(fd);
+        return nullptr;
+    }
+    void* p = mmap(nullptr, mat.bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(mat.shm_name.c_str());
+        return nullptr;
+    }
+    mat.data = static_cast<double*>(p);
+    return &(matrices[name] = mat);
+}
+
+void multiply(const double* A, const double* B, double* C, uint32_t M, WorkerPool& pool) {
+    pool.parallel_rows(M, [=](uint32_t i) {
+        double* c = C + static_cast<size_t>(i) * M;
+        fill(c, c + M, 0.0);
+        for (uint32_t k = 0; k < M; ++k) {
+            double a = A[static_cast<size_t>(i) * M + k];
+            const double* b = B + static_cast<size_t>(k) * M;
+            for (uint32_t j = 0; j < M; ++j)
+                c[j] += a * b[j];
+        }
+    });
+}
+
+string describe(const string& name, const SharedMatrix& mat) {
+    return name + " " + to_string(mat.M) + " /dev/shm" + mat.shm_name;
+}
+
+// One request line in, one reply line out ("OK ..." or "ERR ...").
+string handle(const string& line, WorkerPool& pool, bool& quit) {
+    istringstream in(line);
+    string cmd;
+    in >> cmd;
+
+    if (cmd == "LOAD") {
+        string name, file;
+        in >> name >> file;
+        if (!valid_name(name)) return "ERR bad matrix name";
+        auto t0 = steady_clock::now();
+        MappedMatrix src;
+        if (!map_matrix(file, src)) return "ERR cannot map " + file;
+        SharedMatrix* mat = ensure_matrix(name, src.M);
+        if (!mat) {
+            unmap_matrix(src);
+            return "ERR cannot allocate shared memory";
+        }
+        copy(src.data, src.data + static_cast<size_t>(src.M) * src.M, mat->data);
+        unmap_matrix(src);
+        double ms = duration<double, milli>(steady_clock::now() - t0).count();
+        return "OK " + describe(name, *mat) + " " + to_string(ms);
+    }
+
+    if (cmd == "MUL") {
+        // MUL C A B [repeat]: C = A B, optionally repeated to time warm runs
+        string c_name, a_name, b_name;
+        int repeat = 1;
+        in >> c_name >> a_name >> b_name;
+        if (!(in >> repeat) || repeat < 1) repeat = 1;
+        if (!valid_name(c_name) || c_name == a_name || c_name == b_name) return "ERR bad result name";
+        auto a = matrices.find(a_name), b = matrices.find(b_name);
+        if (a == matrices.end() || b == matrices.end()) return "ERR unknown operand";
+        if (a->second.M != b->second.M) return "ERR operand sizes differ";
+        uint32_t M = a->second.M;
+        SharedMatrix* c = ensure_matrix(c_name, M);
+        if (!c) return "ERR cannot allocate shared memory";
+        const double* A = a->second.data;
+        const double* B = b->second.data;
+
+        auto t0 = steady_clock::now();
+        for (int r = 0; r < repeat; ++r)
+            multiply(A, B, c->data, M, pool);
+        double ms = duration<double, milli>(steady_clock::now() - t0).count() / repeat;
+        return "OK " + describe(c_name, *c) + " " + to_string(ms);
+    }
+
+    if (cmd == "ATTACH") {
+        string name;
+        in >> name;
+        auto it = matrices.find(name);
+        if (it == matrices.end()) return "ERR unknown matrix";
+        return "OK " + describe(name, it->second);
+    }
+
+    if (cmd == "SAVE") {
+        string name, file;
+        in >> name >> file;
+        auto it = matrices.find(name);
+        if (it == matrices.end()) return "ERR unknown matrix";
+        FILE* f = fopen(file.c_str(), "wb");
+        if (!f) return "ERR cannot open " + file;
+        fwrite(it->second.data, 1, it->second.bytes, f);
+        fclose(f);
+        return "OK " + describe(name, it->second);
+    }
+
+    if (cmd == "DROP") {
+        string name;
+        in >> name;
+        auto it = matrices.find(name);
+        if (it == matrices.end()) return "ERR unknown matrix";
+        release_shared(it->second);
+        matrices.erase(it);
+        return "OK";
+    }
+
+    if (cmd == "LIST") {
+        string out = "OK";
+        for (const auto& e : matrices)
+            out += " " + e.first + ":" + to_string(e.second.M);
+        return out;
+    }
+
+    if (cmd == "QUIT") {
+        quit = true;
+        return "OK";
+    }
+
+    return "ERR unknown command " + cmd;
+}
+
+string read_line(int fd) {
+    string line;
+    char ch;
+    while (read(fd, &ch, 1) == 1 && ch != '\n')
+        line += ch;
+    return line;
+}
+
+void write_line(int fd, const string& line) {
+    string out = line + "\n";
+    size_t off = 0;
+    while (off < out.size()) {
+        ssize_t n = write(fd, out.data() + off, out.size() - off);
+        if (n <= 0) return;
+        off += n;
+    }
+}
+
+sockaddr_un socket_address(const string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    return addr;
+}
+
+int serve(const string& path, int num_threads) {
+    signal(SIGPIPE, SIG_IGN);
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = socket_address(path);
+    unlink(path.c_str());
+    if (bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(server, 8) != 0) {
+        cerr << "Cannot listen on " << path << endl;
+        return 1;
+    }
+
+    WorkerPool pool(num_threads);
+    cout << "Matrix service on " << path << " with " << pool.size() << " threads" << endl;
+
+    bool quit = false;
+    while (!quit) {
+        int client = accept(server, nullptr, nullptr);
+        if (client < 0) continue;
+        string request = read_line(client);
+        string reply = handle(request, pool, quit);
+        write_line(client, reply);
+        close(client);
+        cout << request << " -> " << reply << endl;
+    }
+
+    for (auto& e : matrices)
+        release_shared(e.second);
+    close(server);
+    unlink(path.c_str());
+    return 0;
+}
+
+int request(const string& path, const string& line) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = socket_address(path);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        cerr << "Cannot connect to " << path << endl;
+        return 2;
+    }
+    write_line(fd, line);
+    string reply = read_line(fd);
+    close(fd);
+    cout << reply << endl;
+    return reply.compare(0, 2, "OK") == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    string path = get_option(argc, argv, "socket", "/tmp/matrix_service.sock");
+    int num_threads = stoi(get_option(argc, argv, "threads", to_string(thread::hardware_concurrency())));
+
+    vector<string> words;
+    for (int i = 1; i < argc; ++i)
+        if (string(argv[i]).compare(0, 2, "--") != 0)
+            words.push_back(argv[i]);
+
+    if (words.empty()) {
+        cerr << "Usage: " << argv[0] << " serve [--socket=PATH] [--threads=N]\n"
+             << "       " << argv[0] << " LOAD|MUL|ATTACH|SAVE|DROP|LIST|QUIT ... [--socket=PATH]" << endl;
+        return 2;
+    }
+    if (words[0] == "serve")
+        return serve(path, max(1, num_threads));
+
+    string line;
+    for (const auto& w : words)
+        line += (line.empty() ? "" : " ") + w;
+    return request(path, line);
+}
@@ -0,0 +1,421 @@
+// PMPI interposition layer: link it in front of the MPI library (or preload it)
+// and every traced call is timed, with bytes and peer, into a per-rank ring
+// buffer. At MPI_Finalize rank 0 gathers the buffers, writes a Chrome trace /
+// Perfetto JSON timeline (one track per rank) and prints how each rank's time
+// between MPI_Init and MPI_Finalize splits into compute, communication and wait.
+//
+// Environment: MPI_TRACE_FILE (default mpi_trace.json), MPI_TRACE_EVENTS
+// (ring capacity per rank, default 65536; the oldest events are overwritten).
+// Only the thread that calls MPI is traced, which is all the drivers need
+// (MPI_THREAD_FUNNELED at most).
+#include <mpi.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <map>
+
+using namespace std;
+
+namespace {
+
+enum Op : uint16_t {
+    OP_SEND, OP_RECV, OP_SENDRECV, OP_SENDRECV_REPLACE, OP_ISEND, OP_IRECV, OP_STARTALL,
+    OP_BCAST, OP_IBCAST, OP_SCATTER, OP_SCATTERV, OP_GATHER, OP_GATHERV, OP_REDUCE, OP_ALLREDUCE,
+    OP_FILE_READ_ALL, OP_FILE_WRITE_ALL,
+    OP_WAIT, OP_WAITALL, OP_WAITANY, OP_WAITSOME, OP_TEST, OP_TESTALL, OP_TESTANY, OP_TESTSOME, OP_BARRIER,
+    OP_COUNT
+};
+
+const char* const OP_NAMES[OP_COUNT] = {
+    "MPI_Send", "MPI_Recv", "MPI_Sendrecv", "MPI_Sendrecv_replace", "MPI_Isend", "MPI_Irecv", "MPI_Startall",
+    "MPI_Bcast", "MPI_Ibcast", "MPI_Scatter", "MPI_Scatterv", "MPI_Gather", "MPI_Gatherv",
+    "MPI_Reduce", "MPI_Allreduce",
+    "MPI_File_read_all", "MPI_File_write_all",
+    "MPI_Wait", "MPI_Waitall", "MPI_Waitany", "MPI_Waitsome",
+    "MPI_Test", "MPI_Testall", "MPI_Testany", "MPI_Testsome", "MPI_Barrier"
+};
+
+// Time blocked in completion / synchronisation calls counts as wait, the rest
+// of the traced calls as communication.
+bool is_wait(uint16_t op) {
+    return op >= OP_WAIT && op <= OP_BARRIER;
+}
+
+struct TraceEvent {
+    double start, end;   // seconds since the post-MPI_Init barrier
+    uint64_t bytes;
+    int32_t peer;        // world rank of the peer / root, -1 if none
+    uint16_t op;
+};
+
+struct Ring {
+    vector<TraceEvent> events;
+    uint64_t total = 0;
+};
+
+Ring ring;
+double t_origin = 0.0, t_init_end = 0.0;
+double comm_time = 0.0, wait_time = 0.0;
+uint64_t comm_bytes = 0;
+bool tracing = false;
+
+void record(uint16_t op, double start, double end, uint64_t bytes, int peer) {
+    if (!tracing) return;
+    if (is_wait(op)) wait_time += end - start;
+    else comm_time += end - start;
+    comm_bytes += bytes;
+    ring.events[ring.total % ring.events.size()] = { start - t_origin, end - t_origin, bytes, peer, op };
+    ++ring.total;
+}
+
+uint64_t bytes_of(int count, MPI_Datatype type) {
+    int size = 0;
+    PMPI_Type_size(type, &size);
+    return static_cast<uint64_t>(count) * size;
+}
+
+// World rank of every rank of a communicator, translated on first use so the
+// traced calls do not create and free groups each time. An entry is dropped in
+// MPI_Comm_free, before the handle can be reused for another communicator.
+map<MPI_Comm, vector<int>> peer_cache;
+
+const vector<int>& world_ranks(MPI_Comm comm) {
+    auto it = peer_cache.find(comm);
+    if (it != peer_cache.end()) return it->second;
+
+    // Peer ranks of an intercommunicator refer to the remote group
+    int inter = 0;
+    PMPI_Comm_test_inter(comm, &inter);
+    MPI_Group group, world;
+    if (inter) PMPI_Comm_remote_group(comm, &group);
+    else PMPI_Comm_group(comm, &group);
+    PMPI_Comm_group(MPI_COMM_WORLD, &world);
+
+    int size;
+    PMPI_Group_size(group, &size);
+    vector<int> ranks(size), peers(size);
+    for (int r = 0; r < size; ++r) ranks[r] = r;
+    PMPI_Group_translate_ranks(group, size, ranks.data(), world, peers.data());
+    PMPI_Group_free(&group);
+    PMPI_Group_free(&world);
+    for (int& p : peers)
+        if (p == MPI_UNDEFINED) p = -1;
+    return peer_cache.emplace(comm, move(peers)).first->second;
+}
+
+int world_peer(MPI_Comm comm, int rank) {
+    if (rank < 0 || comm == MPI_COMM_WORLD || !tracing) return rank;
+    const vector<int>& peers = world_ranks(comm);
+    return rank < static_cast<int>(peers.size()) ? peers[rank] : -1;
+}
+
+void start_tracing() {
+    const char* cap = getenv("MPI_TRACE_EVENTS");
+    ring.events.resize(cap ? strtoull(cap, nullptr, 10) : 65536);
+    if (ring.events.empty()) ring.events.resize(1);
+    PMPI_Barrier(MPI_COMM_WORLD);
+    t_origin = PMPI_Wtime();
+    t_init_end = t_origin;
+    tracing = true;
+}
+
+void append_event(string& out, const TraceEvent& e, int rank) {
+    char line[256];
+    snprintf(line, sizeof(line),
+             "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%d,"
+             "\"args\":{\"bytes\":%llu,\"peer\":%d}},\n",
+             OP_NAMES[e.op], is_wait(e.op) ? "wait" : "comm", e.start * 1e6, (e.end - e.start) * 1e6, rank,
+             static_cast<unsigned long long>(e.bytes), e.peer);
+    out += line;
+}
+
+// Rank 0 collects every ring (oldest event first) and the per-rank totals.
+void write_trace() {
+    tracing = false;
+    double t_end = PMPI_Wtime();
+
+    int rank, size;
+    PMPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    PMPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    size_t cap = ring.events.size();
+    size_t kept = ring.total < cap ? ring.total : cap;
+    vector<TraceEvent> ordered;
+    ordered.reserve(kept);
+    for (uint64_t i = ring.total - kept; i < ring.total; ++i)
+        ordered.push_back(ring.events[i % cap]);
+
+    int local_bytes = static_cast<int>(kept * sizeof(TraceEvent));
+    vector<int> counts(size), displs(size);
+    PMPI_Gather(&local_bytes, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    vector<char> all;
+    if (rank == 0) {
+        int offset = 0;
+        for (int r = 0; r < size; ++r) {
+            displs[r] = offset;
+            offset += counts[r];
+        }
+        all.resize(offset);
+    }
+    PMPI_Gatherv(ordered.data(), local_bytes, MPI_BYTE, all.data(), counts.data(), displs.data(), MPI_BYTE, 0, MPI_COMM_WORLD);
+
+    double summary[5] = { t_end - t_init_end, comm_time, wait_time, static_cast<double>(comm_bytes),
+                          static_cast<double>(ring.total - kept) };
+    vector<double> summaries(5 * size);
+    PMPI_Gather(summary, 5, MPI_DOUBLE, summaries.data(), 5, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+    if (rank != 0) return;
+
+    const char* path = getenv("MPI_TRACE_FILE");
+    if (!path) path = "mpi_trace.json";
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "mpitrace: cannot open %s\n", path);
+        return;
+    }
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (int r = 0; r < size; ++r)
+        fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"rank %d\"}},\n", r, r);
+    string out;
+    for (int r = 0; r < size; ++r) {
+        const TraceEvent* ev = reinterpret_cast<const TraceEvent*>(all.data() + displs[r]);
+        for (size_t i = 0; i < counts[r] / sizeof(TraceEvent); ++i)
+            append_event(out, ev[i], r);
+        fputs(out.c_str(), f);
+        out.clear();
+    }
+    fprintf(f, "{\"name\":\"end\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":0,\"tid\":0}\n]}\n", (t_end - t_origin) * 1e6);
+    fclose(f);
+
+    printf("MPI trace written to %s\n", path);
+    printf("%6s %12s %12s %12s %12s %12s %10s\n", "rank", "total ms", "compute ms", "comm ms", "wait ms", "MB", "dropped");
+    for (int r = 0; r < size; ++r) {
+        const double* s = &summaries[5 * r];
+        double compute = s[0] - s[1] - s[2];
+        printf("%6d %12.3f %12.3f %12.3f %12.3f %12.3f %10.0f\n", r, s[0] * 1e3, compute * 1e3, s[1] * 1e3, s[2] * 1e3,
+               s[3] / 1e6, s[4]);
+    }
+}
+
+} // namespace
+
+extern "C" {
+
+int MPI_Init(int* argc, char*** argv) {
+    int rc = PMPI_Init(argc, argv);
+    start_tracing();
+    return rc;
+}
+
+int MPI_Init_thread(int* argc, char*** argv, int required, int* provided) {
+    int rc = PMPI_Init_thread(argc, argv, required, provided);
+    start_tracing();
+    return rc;
+}
+
+int MPI_Finalize() {
+    write_trace();
+    return PMPI_Finalize();
+}
+
+int MPI_Comm_free(MPI_Comm* comm) {
+    peer_cache.erase(*comm);
+    return PMPI_Comm_free(comm);
+}
+
+int MPI_Send(const void* buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Send(buf, count, type, dest, tag, comm);
+    record(OP_SEND, t0, PMPI_Wtime(), bytes_of(count, type), world_peer(comm, dest));
+    return rc;
+}
+
+int MPI_Recv(void* buf, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm, MPI_Status* status) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Recv(buf, count, type, source, tag, comm, status);
+    record(OP_RECV, t0, PMPI_Wtime(), bytes_of(count, type), world_peer(comm, source));
+    return rc;
+}
+
+int MPI_Sendrecv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, int dest, int sendtag,
+                 void* recvbuf, int recvcount, MPI_Datatype recvtype, int source, int recvtag,
+                 MPI_Comm comm, MPI_Status* status) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Sendrecv(sendbuf, sendcount, sendtype, dest, sendtag, recvbuf, recvcount, recvtype,
+                           source, recvtag, comm, status);
+    record(OP_SENDRECV, t0, PMPI_Wtime(), bytes_of(sendcount, sendtype) + bytes_of(recvcount, recvtype),
+           world_peer(comm, dest));
+    return rc;
+}
+
+int MPI_Sendrecv_replace(void* buf, int count, MPI_Datatype type, int dest, int sendtag, int source, int recvtag,
+                         MPI_Comm comm, MPI_Status* status) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Sendrecv_replace(buf, count, type, dest, sendtag, source, recvtag, comm, status);
+    record(OP_SENDRECV_REPLACE, t0, PMPI_Wtime(), 2 * bytes_of(count, type), world_peer(comm, dest));
+    return rc;
+}
+
+int MPI_Isend(const void* buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm, MPI_Request* req) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Isend(buf, count, type, dest, tag, comm, req);
+    record(OP_ISEND, t0, PMPI_Wtime(), bytes_of(count, type), world_peer(comm, dest));
+    return rc;
+}
+
+int MPI_Irecv(void* buf, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm, MPI_Request* req) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Irecv(buf, count, type, source, tag, comm, req);
+    record(OP_IRECV, t0, PMPI_Wtime(), bytes_of(count, type), world_peer(comm, source));
+    return rc;
+}
+
+int MPI_Startall(int count, MPI_Request reqs[]) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Startall(count, reqs);
+    record(OP_STARTALL, t0, PMPI_Wtime(), 0, -1);
+    return rc;
+}
+
+int MPI_Bcast(void* buf, int count, MPI_Datatype type, int root, MPI_Comm comm) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Bcast(buf, count, type, root, comm);
+    record(OP_BCAST, t0, PMPI_Wtime(), bytes_of(count, type), world_peer(comm, root));
+    return rc;
+}
+
+int MPI_Ibcast(void* buf, int count, MPI_Datatype type, int root, MPI_Comm comm, MPI_Request* req) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Ibcast(buf, count, type, root, comm, req);
+    record(OP_IBCAST, t0, PMPI_Wtime(), bytes_of(count, type), world_peer(comm, root));
+    return rc;
+}
+
+int MPI_Scatter(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount,
+                MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Scatter(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    record(OP_SCATTER, t0, PMPI_Wtime(), bytes_of(recvcount, recvtype), world_peer(comm, root));
+    return rc;
+}
+
+int MPI_Scatterv(const void* sendbuf, const int sendcounts[], const int displs[], MPI_Datatype sendtype,
+                 void* recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Scatterv(sendbuf, sendcounts, displs, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    record(OP_SCATTERV, t0, PMPI_Wtime(), bytes_of(recvcount, recvtype), world_peer(comm, root));
+    return rc;
+}
+
+int MPI_Gather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount,
+               MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    record(OP_GATHER, t0, PMPI_Wtime(), bytes_of(sendcount, sendtype), world_peer(comm, root));
+    return rc;
+}
+
+int MPI_Gatherv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, const int recvcounts[],
+                const int displs[], MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm);
+    record(OP_GATHERV, t0, PMPI_Wtime(), bytes_of(sendcount, sendtype), world_peer(comm, root));
+    return rc;
+}
+
+int MPI_Reduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Reduce(sendbuf, recvbuf, count, type, op, root, comm);
+    record(OP_REDUCE, t0, PMPI_Wtime(), bytes_of(count, type), world_peer(comm, root));
+    return rc;
+}
+
+int MPI_Allreduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Allreduce(sendbuf, recvbuf, count, type, op, comm);
+    record(OP_ALLREDUCE, t0, PMPI_Wtime(), bytes_of(count, type), -1);
+    return rc;
+}
+
+int MPI_File_read_all(MPI_File fh, void* buf, int count, MPI_Datatype type, MPI_Status* status) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_File_read_all(fh, buf, count, type, status);
+    record(OP_FILE_READ_ALL, t0, PMPI_Wtime(), bytes_of(count, type), -1);
+    return rc;
+}
+
+int MPI_File_write_all(MPI_File fh, const void* buf, int count, MPI_Datatype type, MPI_Status* status) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_File_write_all(fh, buf, count, type, status);
+    record(OP_FILE_WRITE_ALL, t0, PMPI_Wtime(), bytes_of(count, type), -1);
+    return rc;
+}
+
+int MPI_Wait(MPI_Request* req, MPI_Status* status) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Wait(req, status);
+    record(OP_WAIT, t0, PMPI_Wtime(), 0, -1);
+    return rc;
+}
+
+int MPI_Waitall(int count, MPI_Request reqs[], MPI_Status statuses[]) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Waitall(count, reqs, statuses);
+    record(OP_WAITALL, t0, PMPI_Wtime(), 0, -1);
+    return rc;
+}
+
+// The persistent-request paths (MPI_Startall) may complete through any of
+// these, so they are traced like MPI_Wait / MPI_Waitall.
+int MPI_Waitany(int count, MPI_Request reqs[], int* index, MPI_Status* status) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Waitany(count, reqs, index, status);
+    record(OP_WAITANY, t0, PMPI_Wtime(), 0, -1);
+    return rc;
+}
+
+int MPI_Waitsome(int incount, MPI_Request reqs[], int* outcount, int indices[], MPI_Status statuses[]) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Waitsome(incount, reqs, outcount, indices, statuses);
+    record(OP_WAITSOME, t0, PMPI_Wtime(), 0, -1);
+    return rc;
+}
+
+int MPI_Test(MPI_Request* req, int* flag, MPI_Status* status) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Test(req, flag, status);
+    record(OP_TEST, t0, PMPI_Wtime(), 0, -1);
+    return rc;
+}
+
+int MPI_Testall(int count, MPI_Request reqs[], int* flag, MPI_Status statuses[]) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Testall(count, reqs, flag, statuses);
+    record(OP_TESTALL, t0, PMPI_Wtime(), 0, -1);
+    return rc;
+}
+
+int MPI_Testany(int count, MPI_Request reqs[], int* index, int* flag, MPI_Status* status) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Testany(count, reqs, index, flag, status);
+    record(OP_TESTANY, t0, PMPI_Wtime(), 0, -1);
+    return rc;
+}
+
+int MPI_Testsome(int incount, MPI_Request reqs[], int* outcount, int indices[], MPI_Status statuses[]) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Testsome(incount, reqs, outcount, indices, statuses);
+    record(OP_TESTSOME, t0, PMPI_Wtime(), 0, -1);
+    return rc;
+}
+
+int MPI_Barrier(MPI_Comm comm) {
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Barrier(comm);
+    record(OP_BARRIER, t0, PMPI_Wtime(), 0, -1);
+    return rc;
+}
+
+} // extern "C"
@@ -0,0 +1,128 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "matrix_file.h"
+#include "matrix_codec.h"
+
+using namespace std;
+using namespace std::chrono;
+
+string get_option(int argc, char* argv[], const string& name, const string& def) {
+    string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0)
+            return arg.substr(prefix.size());
+    }
+    return def;
+}
+
+// Pushes the file out of the page cache so the next read comes from the disk.
+void drop_cache(const string& fileName) {
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+// M of a raw .bin or .mtxz file, 0 if it is neither.
+uint32_t file_side(const string& fileName) {
+    ifstream rf(fileName, ios::in | ios::binary | ios::ate);
+    if (!rf.is_open()) return 0;
+    size_t size = static_cast<size_t>(rf.tellg());
+    rf.seekg(0);
+    matrix_codec::Header h;
+    if (size >= sizeof(h) && rf.read(reinterpret_cast<char*>(&h), sizeof(h)) &&
+        memcmp(h.magic, matrix_codec::MAGIC, 4) == 0)
+        return h.M;
+    return matrix_side(size);
+}
+
+double timed_read(const string& fileName, vector<double>& mat, uint32_t M, bool cold) {
+    if (cold) drop_cache(fileName);
+    auto t0 = steady_clock::now();
+    if (!matrix_codec::read_matrix(fileName, mat.data(), M)) exit(2);
+    return duration<double, milli>(steady_clock::now() - t0).count();
+}
+
+// Compression ratio, encode / decode throughput, and raw read against
+// compressed read + decode, cold (page cache dropped) and warm.
+int bench(const string& fileName, uint32_t chunk) {
+    uint32_t M = file_side(fileName);
+    if (M == 0) {
+        cerr << fileName << " is not a matrix file" << endl;
+        return 2;
+    }
+    vector<double> mat(static_cast<size_t>(M) * M), back(mat.size());
+    if (!matrix_codec::read_matrix(fileName, mat.data(), M)) return 2;
+    double raw_bytes = mat.size() * sizeof(double);
+
+    auto t0 = steady_clock::now();
+    vector<uint8_t> image = matrix_codec::compress(mat.data(), M, chunk);
+    double t_encode = duration<double, milli>(steady_clock::now() - t0).count();
+    t0 = steady_clock::now();
+    bool ok = matrix_codec::decompress(image.data(), image.size(), back.data(), M);
+    double t_decode = duration<double, milli>(steady_clock::now() - t0).count();
+    if (!ok || memcmp(mat.data(), back.data(), raw_bytes) != 0) {
+        cerr << "Round trip failed" << endl;
+        return 1;
+    }
+
+    string raw_file = fileName + ".bench.bin", z_file = fileName + ".bench.mtxz";
+    matrix_codec::write_matrix(raw_file, mat.data(), M);
+    matrix_codec::write_compressed(z_file, mat.data(), M, chunk);
+
+    cout << "M = " << M << ", " << raw_bytes / 1e6 << " MB -> " << image.size() / 1e6 << " MB, ratio "
+         << raw_bytes / image.size() << endl;
+    cout << "Encode: " << t_encode << " ms (" << raw_bytes / 1e6 / t_encode << " GB/s)" << endl;
+    cout << "Decode: " << t_decode << " ms (" << raw_bytes / 1e6 / t_decode << " GB/s)" << endl;
+    for (bool cold : { true, false }) {
+        timed_read(raw_file, back, M, cold);
+        timed_read(z_file, back, M, cold);
+        double t_raw = timed_read(raw_file, back, M, cold);
+        double t_z = timed_read(z_file, back, M, cold);
+        cout << (cold ? "Cold" : "Warm") << " read: raw " << t_raw << " ms, compressed + decode " << t_z
+             << " ms -> " << (t_z < t_raw ? "compressed wins" : "raw wins") << endl;
+    }
+    unlink(raw_file.c_str());
+    unlink(z_file.c_str());
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3 || argv[1][0] == '-') {
+        cerr << "Usage: " << argv[0] << " c in.bin out.mtxz [--chunk=65536]\n"
+             << "       " << argv[0] << " d in.mtxz out.bin\n"
+             << "       " << argv[0] << " bench in.bin [--chunk=65536]" << endl;
+        return 2;
+    }
+    string mode = argv[1];
+    uint32_t chunk = stoul(get_option(argc, argv, "chunk", to_string(matrix_codec::DEFAULT_CHUNK)));
+
+    if (mode == "bench")
+        return bench(argv[2], chunk);
+
+    if (argc < 4 || (mode != "c" && mode != "d")) {
+        cerr << "Unknown mode " << mode << endl;
+        return 2;
+    }
+    uint32_t M = file_side(argv[2]);
+    if (M == 0) {
+        cerr << argv[2] << " is not a matrix file" << endl;
+        return 2;
+    }
+    vector<double> mat(static_cast<size_t>(M) * M);
+    auto t0 = steady_clock::now();
+    if (!matrix_codec::read_matrix(argv[2], mat.data(), M)) return 2;
+    bool ok = mode == "c" ? matrix_codec::write_compressed(argv[3], mat.data(), M, chunk)
+                          : matrix_codec::write_matrix(argv[3], mat.data(), M);
+    cout << argv[2] << " -> " << argv[3] << " in " << duration<double, milli>(steady_clock::now() - t0).count()
+         << " ms" << endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,304 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+using namespace std;
+
+const char* const PHASES[] = { "T_reading", "T_multiplication", "T_writing", "T_total" };
+const int NUM_PHASES = 4;
+
+// All iterations of one configuration. Variant is the "Variant" column of
+// benchmark.csv or, in the hand-made sheets, the title line above the header.
+struct Key {
+    string variant;
+    double M;
+    int p;
+    bool operator<(const Key& o) const {
+        return tie(variant, M, p) < tie(o.variant, o.M, o.p);
+    }
+};
+
+typedef map<Key, vector<double>[NUM_PHASES]> Runs;
+
+string get_option(int argc, char* argv[], const string& name, const string& def) {
+    string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0)
+            return arg.substr(prefix.size());
+    }
+    return def;
+}
+
+vector<string> split_csv(const string& line) {
+    vector<string> cells;
+    stringstream ss(line);
+    string cell;
+    while (getline(ss, cell, ','))
+        cells.push_back(cell);
+    if (!line.empty() && line.back() == ',') cells.push_back("");
+    for (auto& c : cells) {
+        c.erase(0, c.find_first_not_of(" \t\r"));
+        c.erase(c.find_last_not_of(" \t\r") + 1);
+    }
+    return cells;
+}
+
+// "1000", "10k", "2.5M"
+bool parse_number(const string& s, double& value) {
+    if (s.empty()) return false;
+    char* end;
+    value = strtod(s.c_str(), &end);
+    if (end == s.c_str()) return false;
+    if (*end == 'k' || *end == 'K') value *= 1e3;
+    else if (*end == 'M') value *= 1e6;
+    return true;
+}
+
+// Reads benchmark.csv as well as the lab sheets ("lab2 threds.csv",
+// "OpenMP.csv"): every line holding M, Nr Threds and T_total starts a section,
+// blank M / thread cells repeat the previous row's value, and columns the
+// header does not name (averages, metrics) are ignored.
+Runs read_runs(const string& fileName) {
+    ifstream rf(fileName);
+    if (!rf.is_open()) {
+        cerr << "Cannot open " << fileName << endl;
+        exit(2);
+    }
+    Runs runs;
+    map<string, int> col;
+    string line, title = fileName, variant;
+    double M = 0;
+    int p = 0;
+    while (getline(rf, line)) {
+        vector<string> cells = split_csv(line);
+        auto has = [&](const string& name) { return find(cells.begin(), cells.end(), name) != cells.end(); };
+        if (has("M") && has("Nr Threds") && has("T_total")) {
+            col.clear();
+            for (int i = static_cast<int>(cells.size()) - 1; i >= 0; --i)
+                if (!cells[i].empty()) col[cells[i]] = i;
+            variant = title;
+            M = 0;
+            p = 0;
+            continue;
+        }
+        int non_empty = count_if(cells.begin(), cells.end(), [](const string& c) { return !c.empty(); });
+        if (col.empty() || non_empty == 1) {
+            if (non_empty >= 1)
+                title = *find_if(cells.begin(), cells.end(), [](const string& c) { return !c.empty(); });
+            if (non_empty == 1) col.clear();
+            continue;
+        }
+
+        auto cell = [&](const string& name) -> string {
+            auto it = col.find(name);
+            return it != col.end() && it->second < static_cast<int>(cells.size()) ? cells[it->second] : "";
+        };
+        double value;
+        if (col.count("Variant") && !cell("Variant").empty()) variant = cell("Variant");
+        if (parse_number(cell("M"), value)) M = value;
+        if (parse_number(cell("Nr Threds"), value)) p = static_cast<int>(value);
+        double times[NUM_PHASES];
+        bool ok = M > 0 && p > 0;
+        for (int ph = 0; ph < NUM_PHASES && ok; ++ph)
+            ok = parse_number(cell(PHASES[ph]), times[ph]);
+        if (!ok) continue;
+        auto& samples = runs[{ variant, M, p }];
+        for (int ph = 0; ph < NUM_PHASES; ++ph)
+            samples[ph].push_back(times[ph]);
+    }
+    return runs;
+}
+
+double median(vector<double> v) {
+    sort(v.begin(), v.end());
+    size_t n = v.size();
+    return n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+// Median absolute deviation scaled to a normal sigma.
+double mad_sigma(const vector<double>& v) {
+    double m = median(v);
+    vector<double> dev;
+    for (double x : v) dev.push_back(fabs(x - m));
+    return 1.4826 * median(dev);
+}
+
+// Amdahl: T(p) = T1 (f + (1 - f) / p) = a + b / p, fitted by least squares on
+// 1 / p, so no single-thread run is needed. f = a / (a + b); no fit when
+// T_total does not fall as p grows (b <= 0) or falls faster than 1 / p
+// (a < 0, a negative serial part: superlinear or noisy runs).
+bool fit_amdahl(const vector<pair<int, double>>& points, double& f, double& t1) {
+    if (points.size() < 2) return false;
+    double sx = 0, sy = 0, sxx = 0, sxy = 0, n = points.size();
+    for (const auto& pt : points) {
+        double x = 1.0 / pt.first;
+        sx += x;
+        sy += pt.second;
+        sxx += x * x;
+        sxy += x * pt.second;
+    }
+    double den = n * sxx - sx * sx;
+    if (fabs(den) < 1e-300) return false;
+    double b = (n * sxy - sx * sy) / den;
+    double a = (sy - b * sx) / n;
+    if (b <= 0 || a < 0) return false;
+    t1 = a + b;
+    f = a / t1;
+    return true;
+}
+
+// Gustafson: scaled speed-up S(p) = p - alpha (p - 1), least squares through
+// S(1) = 1.
+bool fit_gustafson(const vector<pair<int, double>>& points, double& alpha) {
+    double num = 0, den = 0;
+    for (const auto& pt : points) {
+        double x = pt.first - 1.0;
+        num += x * (pt.first - pt.second);
+        den += x * x;
+    }
+    if (den == 0) return false;
+    alpha = num / den;
+    return true;
+}
+
+void strong_scaling(const Runs& runs) {
+    map<pair<string, double>, vector<pair<int, double>>> series;
+    for (const auto& r : runs)
+        series[{ r.first.variant, r.first.M }].push_back({ r.first.p, median(r.second[3]) });
+
+    cout << "Strong scaling (median T_total, speed-up against the Amdahl T1 estimate)\n";
+    for (const auto& s : series) {
+        printf("  %s, M=%g\n", s.first.first.c_str(), s.first.second);
+        double f = 0, t1 = 0;
+        bool fitted = fit_amdahl(s.second, f, t1);
+        for (const auto& pt : s.second) {
+            printf("    p=%-4d T_total %12.3f ms", pt.first, pt.second);
+            if (fitted)
+                printf("  speed-up %7.3f  efficiency %6.3f  cost %12.1f", t1 / pt.second, t1 / pt.second / pt.first,
+                       pt.first * pt.second);
+            printf("\n");
+        }
+        if (fitted) {
+            printf("    Amdahl: serial fraction f = %.4f, T1 ~ %.3f ms, max speed-up 1/f = %.1f\n", f, t1,
+                   f > 0 ? 1.0 / f : INFINITY);
+            // Two points determine a and b exactly, so they say nothing about
+            // how well the model fits
+            if (s.second.size() == 2) {
+                printf("    (exact fit through two thread counts, no noise estimate; add a third to check it)\n");
+            }
+            else {
+                double sq = 0;
+                for (const auto& pt : s.second) {
+                    double r = pt.second - t1 * (f + (1 - f) / pt.first);
+                    sq += r * r;
+                }
+                printf("    (fit over %zu thread counts, RMS residual %.3f ms)\n", s.second.size(), sqrt(sq / s.second.size()));
+            }
+        }
+        else {
+            printf("    Amdahl: no fit (needs two or more thread counts with T_total falling, at most as 1 / p)\n");
+        }
+    }
+}
+
+// Weak-scaling points keep the work per processor, M^3 / p, within 15% of
+// the base size's (the smallest M of the variant), whose T1 comes from its
+// Amdahl fit.
+void weak_scaling(const Runs& runs) {
+    map<string, map<double, vector<pair<int, double>>>> by_variant;
+    for (const auto& r : runs)
+        by_variant[r.first.variant][r.first.M].push_back({ r.first.p, median(r.second[3]) });
+
+    cout << "Weak scaling (M^3 / p constant)\n";
+    for (const auto& v : by_variant) {
+        double M0 = v.second.begin()->first, f, t1;
+        if (!fit_amdahl(v.second.begin()->second, f, t1)) {
+            printf("  %s: no T1 estimate for base M=%g\n", v.first.c_str(), M0);
+            continue;
+        }
+        vector<pair<int, double>> points;
+        for (const auto& m : v.second) {
+            double work = pow(m.first / M0, 3);
+            for (const auto& pt : m.second)
+                if (fabs(work / pt.first - 1.0) < 0.15) {
+                    double scaled = work * t1 / pt.second;
+                    points.push_back({ pt.first, scaled });
+                    printf("  %s: M=%g p=%d T_total %.3f ms, scaled speed-up %.3f, efficiency %.3f\n",
+                           v.first.c_str(), m.first, pt.first, pt.second, scaled, scaled / pt.first);
+                }
+        }
+        double alpha;
+        if (points.size() >= 2 && fit_gustafson(points, alpha))
+            printf("  %s: Gustafson serial fraction alpha = %.4f\n", v.first.c_str(), alpha);
+        else
+            printf("  %s: no weak-scaling series (needs runs with M^3 / p equal to M0^3 = %g^3)\n", v.first.c_str(), M0);
+    }
+}
+
+// A phase regresses when its median grows by more than `sigmas` noise
+// (MAD of the baseline and current samples) and by more than `rel` of the
+// baseline median. Returns -1 when no configuration appears in both.
+int detect_regressions(const Runs& baseline, const Runs& current, double sigmas, double rel) {
+    int regressions = 0, matched = 0;
+    cout << "Regressions against baseline (" << sigmas << " sigma, " << rel * 100 << "% minimum)\n";
+    for (const auto& r : current) {
+        auto b = baseline.find(r.first);
+        if (b == baseline.end()) continue;
+        ++matched;
+        for (int ph = 0; ph < NUM_PHASES; ++ph) {
+            double base = median(b->second[ph]), now = median(r.second[ph]);
+            double noise = sqrt(pow(mad_sigma(b->second[ph]), 2) + pow(mad_sigma(r.second[ph]), 2));
+            double delta = now - base;
+            if (delta > sigmas * noise && delta > rel * base) {
+                printf("  REGRESSION %s M=%g p=%d %s: %.3f -> %.3f ms (+%.1f%%, noise %.3f ms)\n",
+                       r.first.variant.c_str(), r.first.M, r.first.p, PHASES[ph], base, now, 100.0 * delta / base, noise);
+                ++regressions;
+            }
+        }
+    }
+    if (matched == 0) {
+        cerr << "No variant / M / p configuration of the results is in the baseline" << endl;
+        return -1;
+    }
+    if (regressions == 0) cout << "  none (" << matched << " configurations compared)\n";
+    return regressions;
+}
+
+int main(int argc, char* argv[]) {
+    vector<string> files;
+    for (int i = 1; i < argc; ++i)
+        if (string(argv[i]).compare(0, 2, "--") != 0)
+            files.push_back(argv[i]);
+    if (files.empty()) {
+        cerr << "Usage: " << argv[0] << " results.csv [more.csv ...] [--baseline=baseline.csv] [--sigmas=3] [--rel=0.05]" << endl;
+        return 2;
+    }
+
+    Runs runs;
+    for (const string& f : files)
+        for (auto& r : read_runs(f))
+            for (int ph = 0; ph < NUM_PHASES; ++ph)
+                runs[r.first][ph].insert(runs[r.first][ph].end(), r.second[ph].begin(), r.second[ph].end());
+    if (runs.empty()) {
+        cerr << "No runs found" << endl;
+        return 2;
+    }
+
+    strong_scaling(runs);
+    weak_scaling(runs);
+
+    string baseline_file = get_option(argc, argv, "baseline", "");
+    if (baseline_file.empty()) return 0;
+    double sigmas = stod(get_option(argc, argv, "sigmas", "3"));
+    double rel = stod(get_option(argc, argv, "rel", "0.05"));
+    int regressions = detect_regressions(read_runs(baseline_file), runs, sigmas, rel);
+    if (regressions < 0) return 2;
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,229 @@
+#ifndef BLOCK_IO_H
+#define BLOCK_IO_H
+
+// Moves the q x q blocks of the MPI drivers (Lab4, Lab4B, Lab5, Lab5B) between the
+// row-major M x M .bin files and the ranks of a Cartesian grid. The caller
+// passes the block position (row, col) it got from MPI_Cart_coords with its
+// rank in the grid communicator, which is not its MPI_COMM_WORLD rank when
+// MPI_Cart_create reorders, so the block always lands where it was computed.
+// ShiftChannel moves a block around a ring of the grid for Cannon's shifts.
+// Include after <mpi.h>.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace block_io {
+
+// The (row, col) block of an M x M matrix as a file view.
+inline MPI_Datatype block_view(int M, int block_size, int row, int col) {
+    int sizes[2] = { M, M };
+    int subsizes[2] = { block_size, block_size };
+    int starts[2] = { row * block_size, col * block_size };
+    MPI_Datatype filetype;
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_DOUBLE, &filetype);
+    MPI_Type_commit(&filetype);
+    return filetype;
+}
+
+// ROMIO collective buffering (two-phase I/O) hints for the collective reads
+// and writes; empty values keep the MPI library defaults.
+inline MPI_Info collective_io_info(const std::string& cb_nodes, const std::string& cb_buffer_size) {
+    MPI_Info info;
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "romio_cb_read", "enable");
+    MPI_Info_set(info, "romio_cb_write", "enable");
+    if (!cb_nodes.empty()) MPI_Info_set(info, "cb_nodes", cb_nodes.c_str());
+    if (!cb_buffer_size.empty()) MPI_Info_set(info, "cb_buffer_size", cb_buffer_size.c_str());
+    return info;
+}
+
+// Collective: every rank of `comm` reads its block, and the MPI-IO layer can
+// merge the strided requests of all ranks (two-phase I/O).
+inline void read_block(double* block, const std::string& fileName, int M, int block_size, int row, int col,
+                       MPI_Comm comm, MPI_Info info = MPI_INFO_NULL) {
+    MPI_Datatype filetype = block_view(M, block_size, row, col);
+    MPI_File file;
+    if (MPI_File_open(comm, fileName.c_str(), MPI_MODE_RDONLY, info, &file) != MPI_SUCCESS) {
+        std::cerr << "Cannot open matrix file " << fileName << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_set_view(file, 0, MPI_DOUBLE, filetype, "native", info);
+    MPI_File_read_all(file, block, block_size * block_size, MPI_DOUBLE, MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+    MPI_Type_free(&filetype);
+}
+
+// Rank 0 of grid_comm reads the file one block at a time and sends it to the
+// owner, so no rank ever holds more than one block of the input.
+inline void read_block_stream(double* block, const std::string& fileName, int M, int block_size, int q,
+                              MPI_Comm grid_comm) {
+    int grid_rank;
+    MPI_Comm_rank(grid_comm, &grid_rank);
+    int block_len = block_size * block_size;
+
+    if (grid_rank != 0) {
+        MPI_Recv(block, block_len, MPI_DOUBLE, 0, 2, grid_comm, MPI_STATUS_IGNORE);
+        return;
+    }
+
+    std::ifstream rf(fileName, std::ios::in | std::ios::binary);
+    if (!rf.is_open()) {
+        std::cerr << "Cannot open matrix file " << fileName << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    std::vector<double> tile(block_len);
+    for (int r = 0; r < q; ++r) {
+        for (int c = 0; c < q; ++c) {
+            int tile_coords[2] = { r, c }, dest;
+            MPI_Cart_rank(grid_comm, tile_coords, &dest);
+            double* target = dest == 0 ? block : tile.data();
+            for (int i = 0; i < block_size; ++i) {
+                rf.seekg((static_cast<std::streamoff>(r * block_size + i) * M + c * block_size) * sizeof(double));
+                rf.read(reinterpret_cast<char*>(target + i * block_size), sizeof(double) * block_size);
+            }
+            if (dest != 0)
+                MPI_Send(tile.data(), block_len, MPI_DOUBLE, dest, 2, grid_comm);
+        }
+    }
+}
+
+// Collective: every rank of `comm` writes its block in place.
+inline void write_block(const double* block, const std::string& fileName, int M, int block_size, int row, int col,
+                        MPI_Comm comm, MPI_Info info = MPI_INFO_NULL) {
+    MPI_Datatype filetype = block_view(M, block_size, row, col);
+    MPI_File file;
+    if (MPI_File_open(comm, fileName.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, info, &file) != MPI_SUCCESS) {
+        std::cerr << "Cannot open file " << fileName << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_set_size(file, static_cast<MPI_Offset>(M) * M * sizeof(double));
+    MPI_File_set_view(file, 0, MPI_DOUBLE, filetype, "native", info);
+    MPI_File_write_all(file, block, block_size * block_size, MPI_DOUBLE, MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+    MPI_Type_free(&filetype);
+}
+
+// One block as a strided piece of the full row-major matrix, resized to one
+// block row (block_size doubles) so Gatherv / Scatterv displacements count
+// block rows. Element offsets would overflow int from M = 46341 on.
+inline MPI_Datatype block_in_matrix(int M, int block_size) {
+    MPI_Datatype strided, resized;
+    MPI_Type_vector(block_size, block_size, M, MPI_DOUBLE, &strided);
+    MPI_Type_create_resized(strided, 0, static_cast<MPI_Aint>(block_size) * sizeof(double), &resized);
+    MPI_Type_commit(&resized);
+    MPI_Type_free(&strided);
+    return resized;
+}
+
+// Offsets of every grid rank's block in the full matrix, in block rows:
+// row r of the grid starts r * block_size * M elements in, which is r * M
+// block rows, and column c is c block rows further.
+inline std::vector<int> block_offsets(int M, MPI_Comm grid_comm) {
+    int size;
+    MPI_Comm_size(grid_comm, &size);
+    std::vector<int> displs(size);
+    for (int r = 0; r < size; ++r) {
+        int coords[2];
+        MPI_Cart_coords(grid_comm, r, 2, coords);
+        displs[r] = coords[0] * M + coords[1];
+    }
+    return displs;
+}
+
+// Collects the blocks into the row-major matrix `full` on rank 0 of
+// grid_comm (only that rank needs `full`), the layout write_block produces.
+inline void gather_matrix(const double* block, double* full, int M, int block_size, MPI_Comm grid_comm) {
+    int size;
+    MPI_Comm_size(grid_comm, &size);
+    MPI_Datatype block_type = block_in_matrix(M, block_size);
+    std::vector<int> counts(size, 1), displs = block_offsets(M, grid_comm);
+    MPI_Gatherv(block, block_size * block_size, MPI_DOUBLE, full, counts.data(), displs.data(), block_type, 0, grid_comm);
+    MPI_Type_free(&block_type);
+}
+
+// Hands out the blocks of the row-major matrix `full`, held by rank 0 of
+// grid_comm, to their owners.
+inline void scatter_matrix(const double* full, double* block, int M, int block_size, MPI_Comm grid_comm) {
+    int size;
+    MPI_Comm_size(grid_comm, &size);
+    MPI_Datatype block_type = block_in_matrix(M, block_size);
+    std::vector<int> counts(size, 1), displs = block_offsets(M, grid_comm);
+    MPI_Scatterv(full, counts.data(), displs.data(), block_type, block, block_size * block_size, MPI_DOUBLE, 0, grid_comm);
+    MPI_Type_free(&block_type);
+}
+
+// A block that travels around a ring of the Cannon grid. It lives in one of
+// two buffers; every shift sends the current buffer and receives into the
+// other one through persistent requests and then swaps, so block data is
+// never copied locally and nothing is allocated per shift.
+struct ShiftChannel {
+    double* buf[2];
+    MPI_Request reqs[2][2];
+    int cur;
+};
+
+// Performs the initial skew by `steps` positions and sets up the persistent
+// one-position shifts (towards rank - 1, from rank + 1) for both buffers.
+inline void init_shift(ShiftChannel& ch, double* block, double* spare, int block_len, int steps, MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    ch.buf[0] = block;
+    ch.buf[1] = spare;
+    ch.cur = 0;
+
+    if (steps % size != 0) {
+        int dst = (rank - steps % size + size) % size;
+        int src = (rank + steps) % size;
+        MPI_Sendrecv(ch.buf[0], block_len, MPI_DOUBLE, dst, 0,
+                     ch.buf[1], block_len, MPI_DOUBLE, src, 0, comm, MPI_STATUS_IGNORE);
+        ch.cur = 1;
+    }
+
+    int prev = (rank - 1 + size) % size;
+    int next = (rank + 1) % size;
+    for (int b = 0; b < 2; ++b) {
+        MPI_Send_init(ch.buf[b], block_len, MPI_DOUBLE, prev, 1, comm, &ch.reqs[b][0]);
+        MPI_Recv_init(ch.buf[b ^ 1], block_len, MPI_DOUBLE, next, 1, comm, &ch.reqs[b][1]);
+    }
+}
+
+// The shift is split so it can run while the current buffer is multiplied:
+// the send only reads it and the receive lands in the other buffer.
+inline void start_shift(ShiftChannel& ch) {
+    MPI_Startall(2, ch.reqs[ch.cur]);
+}
+
+inline void poll_shift(ShiftChannel& ch) {
+    int done;
+    MPI_Testall(2, ch.reqs[ch.cur], &done, MPI_STATUSES_IGNORE);
+}
+
+inline void finish_shift(ShiftChannel& ch) {
+    MPI_Waitall(2, ch.reqs[ch.cur], MPI_STATUSES_IGNORE);
+    ch.cur ^= 1;
+}
+
+inline void shift(ShiftChannel& ch) {
+    start_shift(ch);
+    finish_shift(ch);
+}
+
+inline double* current(const ShiftChannel& ch) {
+    return ch.buf[ch.cur];
+}
+
+inline void free_shift(ShiftChannel& ch) {
+    for (int b = 0; b < 2; ++b) {
+        MPI_Request_free(&ch.reqs[b][0]);
+        MPI_Request_free(&ch.reqs[b][1]);
+    }
+}
+
+} // namespace block_io
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef CONTENT_HASH_H
+#define CONTENT_HASH_H
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// 64-bit content hash in the style of xxHash64: four independent lanes of
+// multiply-rotate over 8-byte words, which runs at memory bandwidth. Used to
+// key cached results, not for anything security related.
+namespace content_hash {
+
+const uint64_t P1 = 0x9E3779B185EBCA87ULL;
+const uint64_t P2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t P3 = 0x165667B19E3779F9ULL;
+const uint64_t P4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t P5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint64_t mix_round(uint64_t acc, uint64_t input) {
+    acc += input * P2;
+    acc = rotl64(acc, 31);
+    return acc * P1;
+}
+
+inline uint64_t merge(uint64_t acc, uint64_t val) {
+    acc ^= mix_round(0, val);
+    return acc * P1 + P4;
+}
+
+inline uint64_t read64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t hash_bytes(const void* data, size_t len, uint64_t seed = 0) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const uint8_t* end = p + len;
+    uint64_t h;
+
+    if (len >= 32) {
+        uint64_t v1 = seed + P1 + P2, v2 = seed + P2, v3 = seed, v4 = seed - P1;
+        const uint8_t* limit = end - 32;
+        do {
+            v1 = mix_round(v1, read64(p));
+            v2 = mix_round(v2, read64(p + 8));
+            v3 = mix_round(v3, read64(p + 16));
+            v4 = mix_round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = merge(h, v1);
+        h = merge(h, v2);
+        h = merge(h, v3);
+        h = merge(h, v4);
+    }
+    else {
+        h = seed + P5;
+    }
+
+    h += static_cast<uint64_t>(len);
+    for (; p + 8 <= end; p += 8) {
+        h ^= mix_round(0, read64(p));
+        h = rotl64(h, 27) * P1 + P4;
+    }
+    for (; p < end; ++p) {
+        h ^= (*p) * P5;
+        h = rotl64(h, 11) * P1;
+    }
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+// Hashes fixed-size chunks in parallel and then hashes the list of chunk
+// hashes, so the result does not depend on the number of threads.
+inline uint64_t parallel_hash(const void* data, size_t len, size_t chunk = size_t(4) << 20) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    size_t chunks = (len + chunk - 1) / chunk;
+    std::vector<uint64_t> hashes(chunks);
+
+#pragma omp parallel for schedule(dynamic)
+    for (long long c = 0; c < static_cast<long long>(chunks); ++c) {
+        size_t begin = c * chunk;
+        size_t size = begin + chunk <= len ? chunk : len - begin;
+        hashes[c] = hash_bytes(p + begin, size, c);
+    }
+
+    return hash_bytes(hashes.data(), hashes.size() * sizeof(uint64_t), len);
+}
+
+inline std::string to_hex(uint64_t h) {
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(h));
+    return buf;
+}
+
+}
+
+#endif
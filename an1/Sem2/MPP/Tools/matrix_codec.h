@@ -0,0 +1,273 @@
+#ifndef MATRIX_CODEC_H
+#define MATRIX_CODEC_H
+
+// Lossless compressed matrix files (.mtxz) next to the raw .bin format.
+// Values are XORed with their predecessor, so neighbours with the same sign,
+// exponent and leading mantissa bits leave leading zero bytes, and values
+// with short mantissas (integers, halves, ...) leave trailing zero bytes.
+// Every value then costs a 4-bit length code plus its non-zero bytes. The
+// matrix is cut into chunks of `chunk_values` doubles, each encoded and
+// decoded on its own (OpenMP threads when built with -fopenmp). A chunk
+// picks whichever of the leading / trailing byte encoding is smaller and
+// falls back to raw doubles when neither saves an eighth, so incompressible
+// data (e.g. random matrices) decodes at memcpy speed and costs one byte per
+// chunk plus the offset table.
+//
+// Layout (little-endian): "MTXZ", version, M, chunk_values, chunk count
+// (uint64), chunk_count + 1 payload offsets (uint64), then the chunks.
+// A chunk is one mode byte, then for the coded modes ceil(n / 2) bytes of
+// length codes followed by the value bytes.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+namespace matrix_codec {
+
+const char MAGIC[4] = { 'M', 'T', 'X', 'Z' };
+const uint32_t VERSION = 1;
+const uint32_t DEFAULT_CHUNK = 1 << 16;
+
+enum Mode : uint8_t { RAW = 0, LEADING = 1, TRAILING = 2 };
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t M;
+    uint32_t chunk_values;
+    uint64_t chunks;
+};
+
+static_assert(sizeof(Header) == 24, "Header must match the file layout");
+
+inline uint64_t bits(double v) {
+    uint64_t u;
+    std::memcpy(&u, &v, sizeof(u));
+    return u;
+}
+
+inline int leading_zero_bytes(uint64_t x) { return x ? __builtin_clzll(x) / 8 : 8; }
+inline int trailing_zero_bytes(uint64_t x) { return x ? __builtin_ctzll(x) / 8 : 8; }
+
+// Low `len` bytes at p; reads a whole word when the buffer allows it.
+inline uint64_t load_bytes(const uint8_t* p, int len, const uint8_t* end) {
+    uint64_t x = 0;
+    if (end - p >= 8) {
+        std::memcpy(&x, p, 8);
+        return len == 8 ? x : x & ((uint64_t(1) << (8 * len)) - 1);
+    }
+    std::memcpy(&x, p, len);
+    return x;
+}
+
+inline void encode_chunk(const double* in, size_t n, std::vector<uint8_t>& out) {
+    size_t leading_bytes = 0, trailing_bytes = 0;
+    uint64_t prev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t x = bits(in[i]) ^ prev;
+        prev = bits(in[i]);
+        leading_bytes += 8 - leading_zero_bytes(x);
+        trailing_bytes += 8 - trailing_zero_bytes(x);
+    }
+    size_t codes = (n + 1) / 2;
+    Mode mode = leading_bytes <= trailing_bytes ? LEADING : TRAILING;
+    size_t coded = 1 + codes + (mode == LEADING ? leading_bytes : trailing_bytes);
+    // Coding has to save an eighth to be worth the slower decode
+    if (coded >= 1 + n * sizeof(double) * 7 / 8) {
+        out.resize(1 + n * sizeof(double));
+        out[0] = RAW;
+        std::memcpy(out.data() + 1, in, n * sizeof(double));
+        return;
+    }
+
+    out.assign(coded, 0);
+    out[0] = mode;
+    uint8_t* code = out.data() + 1;
+    uint8_t* data = code + codes;
+    prev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t x = bits(in[i]) ^ prev;
+        prev = bits(in[i]);
+        int len;
+        if (mode == LEADING) {
+            len = 8 - leading_zero_bytes(x);
+        }
+        else {
+            len = 8 - trailing_zero_bytes(x);
+            if (len) x >>= 64 - 8 * len;
+        }
+        code[i / 2] |= static_cast<uint8_t>(len << (4 * (i & 1)));
+        std::memcpy(data, &x, len);
+        data += len;
+    }
+}
+
+template <Mode mode>
+inline bool decode_values(const uint8_t* code, const uint8_t* data, const uint8_t* end, double* out, size_t n) {
+    // Validate the lengths up front so the decode loop has no checks
+    size_t total = 0;
+    for (size_t i = 0; i < n; ++i) {
+        int len = (code[i / 2] >> (4 * (i & 1))) & 0xF;
+        if (len > 8) return false;
+        total += len;
+    }
+    if (total > static_cast<size_t>(end - data)) return false;
+
+    uint64_t prev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        int len = (code[i / 2] >> (4 * (i & 1))) & 0xF;
+        uint64_t x = load_bytes(data, len, end);
+        data += len;
+        if (mode == TRAILING && len) x <<= 64 - 8 * len;
+        prev ^= x;
+        std::memcpy(&out[i], &prev, sizeof(double));
+    }
+    return true;
+}
+
+inline bool decode_chunk(const uint8_t* in, const uint8_t* end, double* out, size_t n) {
+    if (in >= end) return false;
+    Mode mode = static_cast<Mode>(in[0]);
+    ++in;
+    if (mode == RAW) {
+        if (static_cast<size_t>(end - in) < n * sizeof(double)) return false;
+        std::memcpy(out, in, n * sizeof(double));
+        return true;
+    }
+    size_t codes = (n + 1) / 2;
+    if (static_cast<size_t>(end - in) < codes) return false;
+    if (mode == LEADING) return decode_values<LEADING>(in, in + codes, end, out, n);
+    if (mode == TRAILING) return decode_values<TRAILING>(in, in + codes, end, out, n);
+    return false;
+}
+
+// Encodes the M x M matrix into memory; the chunks are encoded in parallel.
+inline std::vector<uint8_t> compress(const double* mat, uint32_t M, uint32_t chunk_values = DEFAULT_CHUNK) {
+    size_t total = static_cast<size_t>(M) * M;
+    if (chunk_values == 0) chunk_values = DEFAULT_CHUNK;
+    size_t chunks = (total + chunk_values - 1) / chunk_values;
+    std::vector<std::vector<uint8_t>> encoded(chunks);
+
+#pragma omp parallel for schedule(dynamic)
+    for (long c = 0; c < static_cast<long>(chunks); ++c) {
+        size_t lo = static_cast<size_t>(c) * chunk_values;
+        size_t n = std::min<size_t>(chunk_values, total - lo);
+        encode_chunk(mat + lo, n, encoded[c]);
+    }
+
+    Header h;
+    std::memcpy(h.magic, MAGIC, 4);
+    h.version = VERSION;
+    h.M = M;
+    h.chunk_values = chunk_values;
+    h.chunks = chunks;
+    std::vector<uint64_t> offsets(chunks + 1, 0);
+    for (size_t c = 0; c < chunks; ++c)
+        offsets[c + 1] = offsets[c] + encoded[c].size();
+
+    std::vector<uint8_t> out(sizeof(h) + offsets.size() * sizeof(uint64_t) + offsets.back());
+    uint8_t* p = out.data();
+    std::memcpy(p, &h, sizeof(h));
+    p += sizeof(h);
+    std::memcpy(p, offsets.data(), offsets.size() * sizeof(uint64_t));
+    p += offsets.size() * sizeof(uint64_t);
+
+#pragma omp parallel for schedule(dynamic)
+    for (long c = 0; c < static_cast<long>(chunks); ++c)
+        std::memcpy(p + offsets[c], encoded[c].data(), encoded[c].size());
+    return out;
+}
+
+// Decodes a whole .mtxz image into `mat`, which must hold M x M doubles.
+inline bool decompress(const uint8_t* file, size_t size, double* mat, uint32_t M) {
+    Header h;
+    if (size < sizeof(h)) return false;
+    std::memcpy(&h, file, sizeof(h));
+    size_t total = static_cast<size_t>(M) * M;
+    if (std::memcmp(h.magic, MAGIC, 4) != 0 || h.version != VERSION || h.M != M || h.chunk_values == 0 ||
+        h.chunks != (total + h.chunk_values - 1) / h.chunk_values)
+        return false;
+    size_t table = (h.chunks + 1) * sizeof(uint64_t);
+    if (size < sizeof(h) + table) return false;
+    std::vector<uint64_t> offsets(h.chunks + 1);
+    std::memcpy(offsets.data(), file + sizeof(h), table);
+    const uint8_t* payload = file + sizeof(h) + table;
+    size_t payload_size = size - sizeof(h) - table;
+
+    bool ok = true;
+#pragma omp parallel for schedule(dynamic) reduction(&& : ok)
+    for (long c = 0; c < static_cast<long>(h.chunks); ++c) {
+        size_t lo = static_cast<size_t>(c) * h.chunk_values;
+        size_t n = std::min<size_t>(h.chunk_values, total - lo);
+        if (offsets[c] > offsets[c + 1] || offsets[c + 1] > payload_size)
+            ok = false;
+        else
+            ok = decode_chunk(payload + offsets[c], payload + offsets[c + 1], mat + lo, n) && ok;
+    }
+    return ok;
+}
+
+inline bool write_compressed(const std::string& fileName, const double* mat, uint32_t M,
+                             uint32_t chunk_values = DEFAULT_CHUNK) {
+    std::vector<uint8_t> image = compress(mat, M, chunk_values);
+    std::ofstream wf(fileName, std::ios::out | std::ios::binary);
+    if (!wf.is_open()) {
+        std::cerr << "Cannot open output file " << fileName << std::endl;
+        return false;
+    }
+    wf.write(reinterpret_cast<const char*>(image.data()), image.size());
+    return static_cast<bool>(wf);
+}
+
+// Reads either format into `mat` (M x M doubles): .mtxz files are recognised
+// by their magic and decoded, anything else is read as a raw .bin.
+inline bool read_matrix(const std::string& fileName, double* mat, uint32_t M) {
+    std::ifstream rf(fileName, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!rf.is_open()) {
+        std::cerr << "Cannot open matrix file " << fileName << std::endl;
+        return false;
+    }
+    size_t size = static_cast<size_t>(rf.tellg());
+    rf.seekg(0);
+    size_t raw_size = static_cast<size_t>(M) * M * sizeof(double);
+    char magic[4] = {};
+    if (size < sizeof(Header) || !rf.read(magic, 4) || std::memcmp(magic, MAGIC, 4) != 0) {
+        rf.seekg(0);
+        if (size != raw_size || !rf.read(reinterpret_cast<char*>(mat), raw_size)) {
+            std::cerr << fileName << " is not a " << M << " x " << M << " matrix" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<uint8_t> image(size);
+    std::memcpy(image.data(), magic, 4);
+    rf.read(reinterpret_cast<char*>(image.data()) + 4, size - 4);
+    if (!rf || !decompress(image.data(), size, mat, M)) {
+        std::cerr << fileName << " is not a valid compressed " << M << " x " << M << " matrix" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Writes .mtxz when the name ends in ".mtxz", a raw .bin otherwise.
+inline bool write_matrix(const std::string& fileName, const double* mat, uint32_t M) {
+    const std::string ext = ".mtxz";
+    if (fileName.size() > ext.size() && fileName.compare(fileName.size() - ext.size(), ext.size(), ext) == 0)
+        return write_compressed(fileName, mat, M);
+    std::ofstream wf(fileName, std::ios::out | std::ios::binary);
+    if (!wf.is_open()) {
+        std::cerr << "Cannot open output file " << fileName << std::endl;
+        return false;
+    }
+    wf.write(reinterpret_cast<const char*>(mat), static_cast<std::streamsize>(M) * M * sizeof(double));
+    return static_cast<bool>(wf);
+}
+
+} // namespace matrix_codec
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef MATRIX_FILE_H
+#define MATRIX_FILE_H
+
+#include <iostream>
+#include <string>
+#include <cstdint>
+#include <cmath>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Read-only (or shared read-write) mapping of a raw M x M matrix of doubles,
+// the .bin format written by every lab driver.
+struct MappedMatrix {
+    double* data = nullptr;
+    size_t bytes = 0;
+    uint32_t M = 0;
+    int fd = -1;
+};
+
+inline uint32_t matrix_side(size_t bytes) {
+    size_t n = bytes / sizeof(double);
+    uint32_t M = static_cast<uint32_t>(llround(sqrt(static_cast<double>(n))));
+    if (bytes % sizeof(double) != 0 || static_cast<size_t>(M) * M != n)
+        return 0;
+    return M;
+}
+
+inline bool map_matrix(const std::string& fileName, MappedMatrix& mat, bool writable = false) {
+    mat.fd = open(fileName.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (mat.fd < 0) {
+        std::cerr << "Cannot open matrix file " << fileName << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    fstat(mat.fd, &st);
+    mat.bytes = st.st_size;
+    mat.M = matrix_side(mat.bytes);
+    if (mat.M == 0) {
+        std::cerr << fileName << " is not a square matrix of doubles (" << mat.bytes << " bytes)" << std::endl;
+        close(mat.fd);
+        mat.fd = -1;
+        return false;
+    }
+
+    int prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void* p = mmap(nullptr, mat.bytes, prot, MAP_SHARED, mat.fd, 0);
+    if (p == MAP_FAILED) {
+        std::cerr << "Cannot map matrix file " << fileName << std::endl;
+        close(mat.fd);
+        mat.fd = -1;
+        return false;
+    }
+    madvise(p, mat.bytes, MADV_SEQUENTIAL);
+    mat.data = static_cast<double*>(p);
+    return true;
+}
+
+inline void unmap_matrix(MappedMatrix& mat) {
+    if (mat.data) munmap(mat.data, mat.bytes);
+    if (mat.fd >= 0) close(mat.fd);
+    mat = MappedMatrix{};
+}
+
+#endif
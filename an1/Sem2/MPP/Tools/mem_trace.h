@@ -0,0 +1,220 @@
+#ifndef MEM_TRACE_H
+#define MEM_TRACE_H
+
+// Heap and RSS accounting around the driver phases, to find which phase (and
+// which rank) blows up memory at large M. The header replaces the global
+// operator new / delete, so include it from the driver's main file only
+// (one translation unit per program); every allocation then updates the live
+// bytes, the peak and the allocation count with a few relaxed atomics.
+// Set MPP_MEM=1 to get a [mem] line per phase: live heap at the end of the
+// phase, its peak inside the phase, how many allocations the phase made (a
+// count that grows with the number of steps points at a buffer allocated in
+// the loop), and the process' VmHWM / VmRSS. VmHWM is reset at every begin()
+// through /proc/self/clear_refs, so it is the phase's own peak RSS; that also
+// covers malloc / MPI buffers operator new never sees. The drivers print the
+// timeline with report() after their phase timers, so the printing is not
+// timed; report(comm) (defined when <mpi.h> is included first) collects it
+// from every rank and rank 0 prints it.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace mem_trace {
+
+struct Counters {
+    std::atomic<int64_t> live;
+    std::atomic<int64_t> peak;
+    std::atomic<uint64_t> allocs;
+    std::atomic<uint64_t> alloc_bytes;
+};
+
+// Zero-initialised before any dynamic initialiser can allocate.
+inline Counters counters;
+
+// Room for the size in front of each block without breaking the alignment
+// malloc guarantees.
+constexpr size_t HEADER = alignof(std::max_align_t);
+
+inline void* allocate(size_t n) {
+    void* base = std::malloc(n + HEADER);
+    if (!base) return nullptr;
+    *static_cast<size_t*>(base) = n;
+    Counters& c = counters;
+    int64_t live = c.live.fetch_add(static_cast<int64_t>(n), std::memory_order_relaxed) + static_cast<int64_t>(n);
+    int64_t peak = c.peak.load(std::memory_order_relaxed);
+    while (live > peak && !c.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    c.allocs.fetch_add(1, std::memory_order_relaxed);
+    c.alloc_bytes.fetch_add(n, std::memory_order_relaxed);
+    return static_cast<char*>(base) + HEADER;
+}
+
+// Kept out of line: once inlined into operator delete, GCC pairs the free()
+// with the new-expression and warns about the mismatch and the header offset.
+__attribute__((noinline)) inline void deallocate(void* p) {
+    if (!p) return;
+    char* base = static_cast<char*>(p) - HEADER;
+    counters.live.fetch_sub(static_cast<int64_t>(*reinterpret_cast<size_t*>(base)), std::memory_order_relaxed);
+    std::free(base);
+}
+
+// "VmHWM:   123456 kB" -> 123456
+inline long status_kb(const char* field) {
+    FILE* f = std::fopen("/proc/self/status", "r");
+    if (!f) return -1;
+    char line[256];
+    long kb = -1;
+    size_t len = std::strlen(field);
+    while (std::fgets(line, sizeof(line), f))
+        if (std::strncmp(line, field, len) == 0 && line[len] == ':') {
+            kb = std::strtol(line + len + 1, nullptr, 10);
+            break;
+        }
+    std::fclose(f);
+    return kb;
+}
+
+inline bool reset_hwm() {
+    FILE* f = std::fopen("/proc/self/clear_refs", "w");
+    if (!f) return false;
+    bool ok = std::fputs("5", f) >= 0;
+    return std::fclose(f) == 0 && ok;
+}
+
+struct PhaseSample {
+    std::string phase;
+    double live_mb, peak_mb;    // heap through operator new
+    double allocs, alloc_mb;    // made during the phase
+    double hwm_mb, rss_mb;      // whole process, -1 when /proc is unavailable
+};
+
+class MemoryTimeline {
+public:
+    // `print_each` prints every phase as it ends; the drivers turn it off and
+    // call report() once the timers are printed.
+    explicit MemoryTimeline(bool print_each = true) : print_each_(print_each) {
+        const char* env = std::getenv("MPP_MEM");
+        enabled_ = env && std::strcmp(env, "0") != 0;
+    }
+
+    bool enabled() const { return enabled_; }
+    const std::vector<PhaseSample>& samples() const { return samples_; }
+
+    void begin() {
+        if (!enabled_) return;
+        Counters& c = counters;
+        c.peak.store(c.live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        allocs0_ = c.allocs.load(std::memory_order_relaxed);
+        bytes0_ = c.alloc_bytes.load(std::memory_order_relaxed);
+        hwm_reset_ = reset_hwm();
+    }
+
+    void end(const char* phase) {
+        if (!enabled_) return;
+        const double MB = 1024.0 * 1024.0;
+        Counters& c = counters;
+        PhaseSample s;
+        s.phase = phase;
+        s.live_mb = c.live.load(std::memory_order_relaxed) / MB;
+        s.peak_mb = c.peak.load(std::memory_order_relaxed) / MB;
+        s.allocs = static_cast<double>(c.allocs.load(std::memory_order_relaxed) - allocs0_);
+        s.alloc_mb = (c.alloc_bytes.load(std::memory_order_relaxed) - bytes0_) / MB;
+        long hwm = status_kb("VmHWM"), rss = status_kb("VmRSS");
+        s.hwm_mb = hwm < 0 ? -1.0 : hwm / 1024.0;
+        s.rss_mb = rss < 0 ? -1.0 : rss / 1024.0;
+        samples_.push_back(s);
+        if (print_each_) print(s, "");
+    }
+
+    void print(const PhaseSample& s, const char* who) const {
+        std::printf("[mem] %s%s: heap live %.1f MB (phase peak %.1f MB), %.0f allocs / %.1f MB",
+                    who, s.phase.c_str(), s.live_mb, s.peak_mb, s.allocs, s.alloc_mb);
+        if (s.hwm_mb >= 0)
+            std::printf(", VmHWM %.1f MB%s, VmRSS %.1f MB", s.hwm_mb, hwm_reset_ ? "" : " (since start)", s.rss_mb);
+        std::printf("\n");
+        std::fflush(stdout);
+    }
+
+    // This process' timeline, one line per phase.
+    void report() const {
+        if (!enabled_) return;
+        for (const PhaseSample& s : samples_)
+            print(s, "");
+    }
+
+#ifdef MPI_VERSION
+    // Collective over `comm`, every rank must have ended the same phases.
+    // Rank 0 prints its own timeline and, per phase, the rank with the largest
+    // VmHWM and heap peak and the most allocations.
+    void report(MPI_Comm comm) const {
+        if (!enabled_) return;
+        int rank, size;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &size);
+        const int FIELDS = 4;
+        std::vector<double> local;
+        for (const PhaseSample& s : samples_) {
+            double v[FIELDS] = { s.hwm_mb, s.peak_mb, s.allocs, s.live_mb };
+            local.insert(local.end(), v, v + FIELDS);
+        }
+        int n = static_cast<int>(local.size());
+        std::vector<double> all(rank == 0 ? static_cast<size_t>(n) * size : 0);
+        MPI_Gather(local.data(), n, MPI_DOUBLE, all.data(), n, MPI_DOUBLE, 0, comm);
+        if (rank != 0) return;
+
+        for (size_t ph = 0; ph < samples_.size(); ++ph) {
+            print(samples_[ph], "rank 0 ");
+            auto at = [&](int r, int f) { return all[(static_cast<size_t>(r) * samples_.size() + ph) * FIELDS + f]; };
+            int arg[FIELDS - 1] = { 0, 0, 0 };
+            for (int r = 1; r < size; ++r)
+                for (int f = 0; f < FIELDS - 1; ++f)
+                    if (at(r, f) > at(arg[f], f)) arg[f] = r;
+            std::printf("[mem] %s over %d ranks: max VmHWM %.1f MB (rank %d), max heap peak %.1f MB (rank %d),"
+                        " max allocs %.0f (rank %d)\n",
+                        samples_[ph].phase.c_str(), size, at(arg[0], 0), arg[0], at(arg[1], 1), arg[1],
+                        at(arg[2], 2), arg[2]);
+        }
+        std::fflush(stdout);
+    }
+#endif
+
+private:
+    bool enabled_ = false;
+    bool print_each_ = true;
+    bool hwm_reset_ = false;
+    uint64_t allocs0_ = 0, bytes0_ = 0;
+    std::vector<PhaseSample> samples_;
+};
+
+} // namespace mem_trace
+
+// Replacement allocation functions; these may not be inline, hence the
+// one-translation-unit rule above. The aligned (align_val_t) forms are left
+// to the library.
+void* operator new(size_t n) {
+    if (void* p = mem_trace::allocate(n)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t n) {
+    if (void* p = mem_trace::allocate(n)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t n, const std::nothrow_t&) noexcept { return mem_trace::allocate(n); }
+void* operator new[](size_t n, const std::nothrow_t&) noexcept { return mem_trace::allocate(n); }
+
+void operator delete(void* p) noexcept { mem_trace::deallocate(p); }
+void operator delete[](void* p) noexcept { mem_trace::deallocate(p); }
+void operator delete(void* p, size_t) noexcept { mem_trace::deallocate(p); }
+void operator delete[](void* p, size_t) noexcept { mem_trace::deallocate(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { mem_trace::deallocate(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { mem_trace::deallocate(p); }
+
+#endif
@@ -0,0 +1,228 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+// Hardware counters around the driver phases. Set MPP_PERF=1 to enable; each
+// phase then prints cycles, instructions, LLC misses (x 64 B as a DRAM traffic
+// estimate), GFLOP/s, arithmetic intensity and where that lands against a
+// roofline measured on this machine (FMA peak and a triad bandwidth test).
+// Counters come from perf_event_open on Linux and inherit to threads created
+// after the profiler, so OpenMP / std::thread workers are included. Without
+// counters (other OS, perf_event_paranoid, no PMU in a VM) the traffic falls
+// back to the compulsory bytes the driver passes in.
+
+#include <iostream>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+struct Roofline {
+    double peak_gflops = 0.0;
+    double bandwidth_gbs = 0.0;
+};
+
+namespace perf_detail {
+
+// Inputs and results go through volatiles so the loops can neither be
+// constant-folded nor dropped.
+inline double opaque(double v) {
+    static volatile double source;
+    source = v;
+    return source;
+}
+
+inline void keep(double v) {
+    static volatile double sink;
+    sink = v;
+    (void)sink;
+}
+
+// 64 independent FMA chains per thread, enough to cover the FMA latency even
+// when they are vectorised into a few wide registers.
+inline double fma_gflops(int threads) {
+    const long iters = 5000000;
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t)
+        pool.emplace_back([] {
+            double a[64];
+            const double x = opaque(0.999999999), y = opaque(1e-9);
+            for (int i = 0; i < 64; ++i) a[i] = 1.0 + i * y;
+            for (long it = 0; it < iters; ++it)
+#pragma GCC unroll 64
+                for (int i = 0; i < 64; ++i)
+                    a[i] = a[i] * x + y;
+            double s = 0.0;
+            for (double v : a) s += v;
+            keep(s);
+        });
+    for (auto& th : pool) th.join();
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return 2.0 * 64 * iters * threads / sec / 1e9;
+}
+
+// a = b + s c over arrays well beyond the LLC; counts 3 x 8 bytes per element.
+inline double triad_gbs(int threads) {
+    const size_t n = size_t(1) << 24;
+    std::vector<double> a(n, 0.0), b(n, 1.0), c(n, 2.0);
+    double best = 0.0;
+    for (int rep = 0; rep < 3; ++rep) {
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; ++t)
+            pool.emplace_back([&, t] {
+                size_t lo = n * t / threads, hi = n * (t + 1) / threads;
+                for (size_t i = lo; i < hi; ++i)
+                    a[i] = b[i] + 3.0 * c[i];
+            });
+        for (auto& th : pool) th.join();
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        best = std::max(best, 3.0 * sizeof(double) * n / sec / 1e9);
+    }
+    keep(a[n / 2]);
+    return best;
+}
+
+} // namespace perf_detail
+
+inline Roofline measure_roofline(int threads) {
+    Roofline r;
+    r.peak_gflops = perf_detail::fma_gflops(threads);
+    r.bandwidth_gbs = perf_detail::triad_gbs(threads);
+    return r;
+}
+
+class PhaseProfiler {
+public:
+    enum { CYCLES, INSTRUCTIONS, LLC_MISSES, NUM_COUNTERS };
+
+    // Construct it before the timed phases: when enabled, the roofline is
+    // measured here. `active` = false turns it off regardless of MPP_PERF
+    // (e.g. on all MPI ranks but one).
+    explicit PhaseProfiler(int threads = static_cast<int>(std::thread::hardware_concurrency()), bool active = true) {
+        enabled_ = active && requested();
+        if (!enabled_) return;
+        roofline_ = measure_roofline(std::max(1, threads));
+#ifdef __linux__
+        const uint64_t configs[NUM_COUNTERS] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                 PERF_COUNT_HW_CACHE_MISSES };
+        for (int c = 0; c < NUM_COUNTERS; ++c) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[c];
+            attr.disabled = 1;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds_[c] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#endif
+    }
+
+    ~PhaseProfiler() {
+#ifdef __linux__
+        for (int fd : fds_)
+            if (fd >= 0) close(fd);
+#endif
+    }
+
+    PhaseProfiler(const PhaseProfiler&) = delete;
+    PhaseProfiler& operator=(const PhaseProfiler&) = delete;
+
+    bool enabled() const { return enabled_; }
+
+    // Whether MPP_PERF asks for counters, the same on every MPI rank (unlike
+    // enabled()), so ranks can agree on synchronising around the profiler.
+    static bool requested() {
+        const char* env = std::getenv("MPP_PERF");
+        return env && std::strcmp(env, "0") != 0;
+    }
+
+    void begin() {
+        if (!enabled_) return;
+#ifdef __linux__
+        for (int fd : fds_)
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        start_ = std::chrono::steady_clock::now();
+    }
+
+    // `flops` is the useful work of the phase (2 M^3 for a multiply) and
+    // `min_bytes` its compulsory memory traffic, used when LLC misses are not
+    // available.
+    void end(const char* phase, double flops, double min_bytes) {
+        if (!enabled_) return;
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        double values[NUM_COUNTERS];
+        bool have[NUM_COUNTERS];
+        for (int c = 0; c < NUM_COUNTERS; ++c)
+            have[c] = read_counter(c, values[c]);
+
+        std::printf("[perf] %s: %.3f ms", phase, sec * 1e3);
+        if (have[CYCLES]) std::printf(", %.3g cycles", values[CYCLES]);
+        if (have[CYCLES] && have[INSTRUCTIONS] && values[CYCLES] > 0)
+            std::printf(", IPC %.2f", values[INSTRUCTIONS] / values[CYCLES]);
+        bool measured = have[LLC_MISSES];
+        double bytes = measured ? values[LLC_MISSES] * 64.0 : min_bytes;
+        if (measured) std::printf(", LLC misses %.3g", values[LLC_MISSES]);
+        if (!have[CYCLES] && !have[INSTRUCTIONS] && !measured) std::printf(", counters unavailable");
+        std::printf(", DRAM %.1f MB (%.2f GB/s%s)", bytes / 1e6, bytes / sec / 1e9, measured ? "" : ", compulsory estimate");
+
+        if (flops > 0) {
+            double gflops = flops / sec / 1e9;
+            double ai = bytes > 0 ? flops / bytes : 0.0;
+            double ridge = roofline_.peak_gflops / roofline_.bandwidth_gbs;
+            double attainable = std::min(roofline_.peak_gflops, ai * roofline_.bandwidth_gbs);
+            std::printf("\n[perf] %s: %.2f GFLOP/s, AI %.2f flop/B; roofline peak %.1f GFLOP/s, %.1f GB/s,"
+                        " ridge %.2f flop/B -> %s, %.1f%% of attainable %.1f GFLOP/s",
+                        phase, gflops, ai, roofline_.peak_gflops, roofline_.bandwidth_gbs, ridge,
+                        ai >= ridge ? "compute-bound" : "memory-bound",
+                        attainable > 0 ? 100.0 * gflops / attainable : 0.0, attainable);
+        }
+        std::printf("\n");
+        std::fflush(stdout);
+    }
+
+private:
+    bool read_counter(int c, double& value) {
+#ifdef __linux__
+        int fd = fds_[c];
+        if (fd < 0) return false;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t data[3];
+        if (read(fd, data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)) || data[2] == 0)
+            return false;
+        // Scale up if the counter was multiplexed for part of the phase
+        value = static_cast<double>(data[0]) * (static_cast<double>(data[1]) / data[2]);
+        return true;
+#else
+        (void)c;
+        (void)value;
+        return false;
+#endif
+    }
+
+    bool enabled_ = false;
+    int fds_[NUM_COUNTERS] = { -1, -1, -1 };
+    Roofline roofline_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#endif
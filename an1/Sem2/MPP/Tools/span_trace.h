@@ -0,0 +1,196 @@
+#ifndef SPAN_TRACE_H
+#define SPAN_TRACE_H
+
+// Scoped spans per thread, to see where threads sit idle. Enable by setting
+// MPP_TRACE to an output file (e.g. MPP_TRACE=trace.json); otherwise a span
+// costs one branch. Each thread appends to its own buffer (the rdtsc counter
+// on x86, steady_clock elsewhere), so recording takes no locks after a
+// thread's first span. finish() writes a Chrome trace (chrome://tracing or
+// Perfetto) and prints per-thread busy time and the imbalance ratio
+// max / mean of the top-level busy time.
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace span_trace {
+
+struct Span {
+    uint64_t start, end;
+    const char* name;
+    uint32_t depth;
+};
+
+struct ThreadBuffer {
+    std::vector<Span> spans;
+    uint32_t tid = 0;
+    uint32_t depth = 0;
+};
+
+struct State {
+    bool enabled = false;
+    std::string file;
+    double ns_per_tick = 1.0;
+    uint64_t origin = 0;
+    std::mutex m;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+inline State& state() {
+    static State s;
+    return s;
+}
+
+inline uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline bool enabled() {
+    return state().enabled;
+}
+
+// Reads MPP_TRACE and calibrates the tick rate against steady_clock.
+inline void init() {
+    State& s = state();
+    const char* file = std::getenv("MPP_TRACE");
+    if (!file || !*file) return;
+    s.file = file;
+    auto t0 = std::chrono::steady_clock::now();
+    uint64_t c0 = ticks();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    uint64_t c1 = ticks();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    s.ns_per_tick = ns / static_cast<double>(c1 - c0);
+    s.origin = c0;
+    s.enabled = true;
+}
+
+inline ThreadBuffer& local_buffer() {
+    thread_local ThreadBuffer* buf = nullptr;
+    if (!buf) {
+        State& s = state();
+        std::lock_guard<std::mutex> lk(s.m);
+        s.buffers.push_back(std::make_unique<ThreadBuffer>());
+        buf = s.buffers.back().get();
+        buf->tid = static_cast<uint32_t>(s.buffers.size() - 1);
+        buf->spans.reserve(1024);
+    }
+    return *buf;
+}
+
+class Scope {
+public:
+    explicit Scope(const char* name) {
+        if (!enabled()) return;
+        buf_ = &local_buffer();
+        name_ = name;
+        depth_ = buf_->depth++;
+        start_ = ticks();
+    }
+
+    ~Scope() {
+        if (!buf_) return;
+        uint64_t end = ticks();
+        buf_->depth--;
+        buf_->spans.push_back({ start_, end, name_, depth_ });
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    ThreadBuffer* buf_ = nullptr;
+    const char* name_ = nullptr;
+    uint32_t depth_ = 0;
+    uint64_t start_ = 0;
+};
+
+#define SPAN_TRACE_CAT2(a, b) a##b
+#define SPAN_TRACE_CAT(a, b) SPAN_TRACE_CAT2(a, b)
+#define TRACE_SPAN(name) span_trace::Scope SPAN_TRACE_CAT(span_trace_scope_, __LINE__)(name)
+
+// Sum of this process' top-level spans with the given name (all names if null),
+// in milliseconds; used e.g. to compare MPI ranks.
+inline double busy_ms(const char* name = nullptr) {
+    State& s = state();
+    std::lock_guard<std::mutex> lk(s.m);
+    double total = 0.0;
+    for (const auto& b : s.buffers)
+        for (const Span& sp : b->spans)
+            if (sp.depth == 0 && (!name || std::string(sp.name) == name))
+                total += (sp.end - sp.start) * s.ns_per_tick / 1e6;
+    return total;
+}
+
+// Writes the trace (the file gets ".<pid>" before the extension when pid >= 0,
+// one file per MPI rank) and prints the per-thread summary.
+inline void finish(int pid = -1) {
+    State& s = state();
+    if (!s.enabled) return;
+    std::lock_guard<std::mutex> lk(s.m);
+
+    std::string file = s.file;
+    if (pid >= 0) {
+        // Only a dot in the file name starts the extension, not one in "../trace"
+        size_t slash = file.rfind('/');
+        size_t dot = file.rfind('.');
+        std::string suffix = "." + std::to_string(pid);
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) file += suffix;
+        else file.insert(dot, suffix);
+    }
+
+    FILE* f = std::fopen(file.c_str(), "w");
+    if (f) {
+        std::fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        for (const auto& b : s.buffers)
+            for (const Span& sp : b->spans) {
+                double ts = static_cast<double>(sp.start - s.origin) * s.ns_per_tick / 1e3;
+                double dur = static_cast<double>(sp.end - sp.start) * s.ns_per_tick / 1e3;
+                std::fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u}",
+                             first ? "" : ",\n", sp.name, ts, dur, pid < 0 ? 0 : pid, b->tid);
+                first = false;
+            }
+        std::fprintf(f, "\n]}\n");
+        std::fclose(f);
+    }
+
+    std::vector<double> busy;
+    for (const auto& b : s.buffers) {
+        double t = 0.0;
+        for (const Span& sp : b->spans)
+            if (sp.depth == 0) t += (sp.end - sp.start) * s.ns_per_tick / 1e6;
+        busy.push_back(t);
+    }
+    if (busy.empty()) return;
+    double max_busy = *std::max_element(busy.begin(), busy.end());
+    double mean_busy = 0.0;
+    for (double t : busy) mean_busy += t;
+    mean_busy /= busy.size();
+
+    std::printf("Span trace written to %s\n", file.c_str());
+    for (size_t t = 0; t < busy.size(); ++t)
+        std::printf("  thread %zu busy %.3f ms (%zu spans)\n", t, busy[t], s.buffers[t]->spans.size());
+    std::printf("  imbalance (max / mean busy): %.3f\n", mean_busy > 0 ? max_busy / mean_busy : 1.0);
+    std::fflush(stdout);
+}
+
+} // namespace span_trace
+
+#endif
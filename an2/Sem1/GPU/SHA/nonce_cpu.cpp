@@ -0,0 +1,174 @@
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include "sha1.h"
+#include "sha1_simd.h"
+
+// Host-only build of the nonce search in kernel.cu, for machines without a GPU:
+// the 2^32 nonces are handed out in batches to one worker per core, and the
+// first worker to find a match stops the others. Each worker hashes 4 / 8 / 16
+// nonces per call with the multi-buffer SHA-1 in sha1_simd.h.
+
+const uint64_t NONCE_SPACE = uint64_t(1) << 32;
+const uint32_t BATCH = 1 << 16;
+
+struct SearchResult {
+    bool found = false;
+    uint32_t nonce = 0;
+    uint64_t hashes = 0;
+    double seconds = 0;
+};
+
+bool check_nonce(const uint8_t* data, size_t data_len, const uint8_t* suffix, int suffix_len, uint32_t nonce) {
+    uint8_t buffer[64];
+    uint8_t hash[20];
+    memcpy(buffer, data, data_len);
+    memcpy(buffer + data_len, &nonce, sizeof(nonce));
+    sha1(buffer, data_len + sizeof(nonce), hash);
+    return memcmp(hash + 20 - suffix_len, suffix, suffix_len) == 0;
+}
+
+// ================= CPU NONCE SEARCH =================
+
+SearchResult find_nonce_parallel(const uint8_t* data, size_t data_len,
+    const uint8_t* suffix, int suffix_len, int num_threads, const sha1_simd::Kernel& kernel) {
+    const sha1_simd::NonceJob job = sha1_nonce_job(data, data_len, suffix, suffix_len);
+    std::atomic<uint64_t> next_batch{ 0 };
+    std::atomic<bool> found{ false };
+    std::atomic<uint32_t> result{ 0 };
+    std::atomic<uint64_t> hashes{ 0 };
+
+    auto worker = [&]() {
+        uint64_t done = 0;
+        while (!found.load(std::memory_order_relaxed)) {
+            uint64_t start = next_batch.fetch_add(BATCH);
+            if (start >= NONCE_SPACE) break;
+            uint64_t end = start + BATCH;
+            for (uint64_t n = start; n < end; n += kernel.width) {
+                uint32_t hits = kernel.search(job, static_cast<uint32_t>(n));
+                if (hits) {
+                    uint32_t nonce = static_cast<uint32_t>(n) + __builtin_ctz(hits);
+                    if (!check_nonce(data, data_len, suffix, suffix_len, nonce)) {
+                        std::cerr << kernel.name << " reported a wrong nonce " << nonce << "\n";
+                        std::exit(1);
+                    }
+                    bool expected = false;
+                    if (found.compare_exchange_strong(expected, true))
+                        result = nonce;
+                    done += n - start + kernel.width;
+                    hashes += done;
+                    return;
+                }
+                // Another worker won: drop the rest of the batch
+                if ((n & 1023) == 0 && found.load(std::memory_order_relaxed)) {
+                    done += n - start + kernel.width;
+                    hashes += done;
+                    return;
+                }
+            }
+            done += BATCH;
+        }
+        hashes += done;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (int t = 0; t < num_threads; ++t)
+        pool.emplace_back(worker);
+    for (auto& th : pool)
+        th.join();
+
+    SearchResult r;
+    r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    r.found = found;
+    r.nonce = result;
+    r.hashes = hashes;
+    return r;
+}
+
+void run_cpu_nonce_search(const uint8_t* data, size_t data_len,
+    const uint8_t* suffix, int suffix_len, int num_threads, const sha1_simd::Kernel& kernel) {
+    SearchResult r = find_nonce_parallel(data, data_len, suffix, suffix_len, num_threads, kernel);
+    if (r.found)
+        std::cout << "[CPU x" << num_threads << "] Nonce: " << r.nonce;
+    else
+        std::cout << "[CPU x" << num_threads << "] No nonce in 2^32";
+    std::cout << " | Time: " << r.seconds << " s"
+        << " | " << r.hashes / r.seconds / 1e6 << " MH/s ("
+        << r.hashes / r.seconds / 1e6 / num_threads << " MH/s per thread)\n";
+}
+
+std::string get_option(int argc, char* argv[], const std::string& name, const std::string& def) {
+    std::string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0)
+            return arg.substr(prefix.size());
+    }
+    return def;
+}
+
+// "123456" -> { 0x12, 0x34, 0x56 }; odd lengths or non-hex digits give an empty vector
+std::vector<uint8_t> parse_hex(const std::string& hex) {
+    std::vector<uint8_t> bytes;
+    if (hex.size() % 2 != 0 || hex.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+        return bytes;
+    for (size_t i = 0; i < hex.size(); i += 2)
+        bytes.push_back(static_cast<uint8_t>(std::stoul(hex.substr(i, 2), nullptr, 16)));
+    return bytes;
+}
+
+// ================= MAIN =================
+
+int main(int argc, char* argv[]) {
+    std::string threads = get_option(argc, argv, "threads",
+        std::to_string(std::max(1u, std::thread::hardware_concurrency())));
+    int num_threads = 0;
+    try { num_threads = std::stoi(threads); } catch (...) {}
+    if (num_threads < 1) {
+        std::cerr << "Invalid --threads=" << threads << ", expected a positive count\n";
+        return 1;
+    }
+    std::string text = get_option(argc, argv, "data", "hello");
+    std::string suffix_hex = get_option(argc, argv, "suffix", "");
+    std::string simd = get_option(argc, argv, "simd", "auto");
+    if (!sha1_simd::known_kernel(simd)) {
+        std::cerr << "Unknown --simd=" << simd << " (auto, avx512, avx2, sse2 or scalar)\n";
+        return 1;
+    }
+    sha1_simd::Kernel kernel = sha1_simd::select_kernel(simd);
+    std::cout << "SHA-1 kernel: " << kernel.name << " (" << kernel.width << " nonces per call)";
+    if (simd != "auto" && simd != kernel.name)
+        std::cout << ", " << simd << " is not supported by this CPU";
+    std::cout << "\n";
+
+    std::vector<uint8_t> data(text.begin(), text.end());
+    if (data.size() + sizeof(uint32_t) > 55) {
+        std::cerr << "Data must be at most 51 bytes (one SHA-1 block with the nonce)\n";
+        return 1;
+    }
+
+    // Same suffixes as kernel.cu, including the 4-byte one the single-threaded search skipped
+    std::vector<std::vector<uint8_t>> suffixes;
+    if (suffix_hex.empty())
+        suffixes = { { 0x00 }, { 0x12, 0x34 }, { 0x12, 0x34, 0x56 }, { 0x12, 0x34, 0x56, 0x22 } };
+    else
+        suffixes = { parse_hex(suffix_hex) };
+
+    for (const auto& suffix : suffixes) {
+        if (suffix.empty() || suffix.size() > 20) {
+            std::cerr << "Suffix must be 1 to 20 bytes of hex\n";
+            return 1;
+        }
+        std::cout << "--------------------- SUFIX LEN " << suffix.size() << "\n";
+        run_cpu_nonce_search(data.data(), data.size(), suffix.data(), static_cast<int>(suffix.size()), num_threads, kernel);
+    }
+    return 0;
+}
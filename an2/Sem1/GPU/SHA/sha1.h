@@ -0,0 +1,208 @@
+#ifndef SHA1_H
+#define SHA1_H
+
+// SHA-1 shared by the CUDA build (kernel.cu) and the host-only nonce search
+// (nonce_cpu.cpp); under nvcc the functions are compiled for both sides.
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#ifdef __CUDACC__
+#define SHA1_HD __device__ __host__ inline
+#else
+#define SHA1_HD inline
+#endif
+
+// ================= SHA1 =================
+
+struct SHA1_CTX {
+    uint32_t state[5];
+    uint64_t count;
+    uint8_t buffer[64];
+};
+
+SHA1_HD uint32_t rotl(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+SHA1_HD void sha1_transform(uint32_t state[5], const uint8_t buffer[64]) {
+    uint32_t a, b, c, d, e, t, W[80];
+
+    for (int i = 0; i < 16; i++)
+        W[i] = (buffer[4 * i] << 24) |
+        (buffer[4 * i + 1] << 16) |
+        (buffer[4 * i + 2] << 8) |
+        (buffer[4 * i + 3]);
+
+    for (int i = 16; i < 80; i++)
+        W[i] = rotl(W[i - 3] ^ W[i - 8] ^ W[i - 14] ^ W[i - 16], 1);
+
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+    e = state[4];
+
+    for (int i = 0; i < 80; i++) {
+        if (i < 20)
+            t = rotl(a, 5) + ((b & c) | (~b & d)) + e + W[i] + 0x5A827999;
+        else if (i < 40)
+            t = rotl(a, 5) + (b ^ c ^ d) + e + W[i] + 0x6ED9EBA1;
+        else if (i < 60)
+            t = rotl(a, 5) + ((b & c) | (b & d) | (c & d)) + e + W[i] + 0x8F1BBCDC;
+        else
+            t = rotl(a, 5) + (b ^ c ^ d) + e + W[i] + 0xCA62C1D6;
+
+        e = d;
+        d = c;
+        c = rotl(b, 30);
+        b = a;
+        a = t;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+SHA1_HD void sha1(const uint8_t* data, size_t len, uint8_t hash[20]) {
+    SHA1_CTX ctx{};
+    ctx.state[0] = 0x67452301;
+    ctx.state[1] = 0xEFCDAB89;
+    ctx.state[2] = 0x98BADCFE;
+    ctx.state[3] = 0x10325476;
+    ctx.state[4] = 0xC3D2E1F0;
+    ctx.count = 0;
+
+    size_t i = 0;
+    while (len--) {
+        ctx.buffer[ctx.count & 63] = data[i++];
+        if ((++ctx.count & 63) == 0)
+            sha1_transform(ctx.state, ctx.buffer);
+    }
+
+    uint64_t bit_len = ctx.count * 8;
+    ctx.buffer[ctx.count & 63] = 0x80;
+
+    while ((++ctx.count & 63) != 56)
+        ctx.buffer[ctx.count & 63] = 0;
+
+    for (int j = 7; j >= 0; j--)
+        ctx.buffer[56 + j] = bit_len >> (8 * (7 - j));
+
+    sha1_transform(ctx.state, ctx.buffer);
+
+    for (i = 0; i < 5; i++) {
+        hash[4 * i] = ctx.state[i] >> 24;
+        hash[4 * i + 1] = ctx.state[i] >> 16;
+        hash[4 * i + 2] = ctx.state[i] >> 8;
+        hash[4 * i + 3] = ctx.state[i];
+    }
+}
+
+// ================= NONCE SEARCH =================
+
+// The nonce searches hash data + 4-byte little-endian nonce, always one block,
+// and only the nonce changes. The job holds everything else, done once:
+//  - words: the padded block as big-endian schedule words with the nonce bytes
+//    zero, so no memcpy, padding or ctx.count loop per nonce;
+//  - mid: a..e after the rounds before first_round, the first one reading a
+//    nonce byte (later schedule words all mix the nonce in);
+//  - mask / target: the suffix laid over the final state words, compared as
+//    words instead of serializing the hash. A suffix of up to 4 bytes lies in
+//    state[4] = H4 + rotl(a of round 75, 30), so rounds 76..79 are skipped.
+struct SHA1_NONCE_JOB {
+    uint32_t words[16];
+    int nonce_pos;
+    int first_round;
+    uint32_t mid[5];
+    uint32_t mask[5];
+    uint32_t target[5];
+    bool tail_only;
+};
+
+SHA1_HD void sha1_round(int i, uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d, uint32_t& e, uint32_t w) {
+    uint32_t t;
+    if (i < 20)
+        t = rotl(a, 5) + ((b & c) | (~b & d)) + e + w + 0x5A827999;
+    else if (i < 40)
+        t = rotl(a, 5) + (b ^ c ^ d) + e + w + 0x6ED9EBA1;
+    else if (i < 60)
+        t = rotl(a, 5) + ((b & c) | (b & d) | (c & d)) + e + w + 0x8F1BBCDC;
+    else
+        t = rotl(a, 5) + (b ^ c ^ d) + e + w + 0xCA62C1D6;
+
+    e = d;
+    d = c;
+    c = rotl(b, 30);
+    b = a;
+    a = t;
+}
+
+// data_len + 4 must leave room for the padding in one block (at most 55 bytes),
+// suffix_len is 1 to 20.
+inline SHA1_NONCE_JOB sha1_nonce_job(const uint8_t* data, size_t data_len, const uint8_t* suffix, int suffix_len) {
+    uint8_t block[64] = {};
+    memcpy(block, data, data_len);
+    block[data_len + 4] = 0x80;
+    uint64_t bit_len = (data_len + 4) * 8;
+    for (int j = 0; j < 8; j++)
+        block[63 - j] = static_cast<uint8_t>(bit_len >> (8 * j));
+
+    SHA1_NONCE_JOB job;
+    for (int i = 0; i < 16; i++)
+        job.words[i] = (uint32_t(block[4 * i]) << 24) | (uint32_t(block[4 * i + 1]) << 16) |
+                       (uint32_t(block[4 * i + 2]) << 8) | block[4 * i + 3];
+    job.nonce_pos = static_cast<int>(data_len);
+    job.first_round = job.nonce_pos / 4;
+
+    uint32_t a = 0x67452301, b = 0xEFCDAB89, c = 0x98BADCFE, d = 0x10325476, e = 0xC3D2E1F0;
+    for (int i = 0; i < job.first_round; i++)
+        sha1_round(i, a, b, c, d, e, job.words[i]);
+    job.mid[0] = a;
+    job.mid[1] = b;
+    job.mid[2] = c;
+    job.mid[3] = d;
+    job.mid[4] = e;
+
+    for (int i = 0; i < 5; i++)
+        job.mask[i] = job.target[i] = 0;
+    for (int j = 0; j < suffix_len; j++) {
+        int p = 20 - suffix_len + j;
+        job.mask[p / 4] |= 0xFFu << (8 * (3 - p % 4));
+        job.target[p / 4] |= uint32_t(suffix[j]) << (8 * (3 - p % 4));
+    }
+    job.tail_only = suffix_len <= 4;
+    return job;
+}
+
+// Same answer as hashing data + nonce with sha1() and comparing the suffix.
+SHA1_HD bool sha1_nonce_match(const SHA1_NONCE_JOB& job, uint32_t nonce) {
+    uint32_t W[16];
+    for (int i = 0; i < 16; i++)
+        W[i] = job.words[i];
+    for (int k = 0; k < 4; k++) {
+        int p = job.nonce_pos + k;
+        W[p / 4] |= ((nonce >> (8 * k)) & 0xFF) << (8 * (3 - p % 4));
+    }
+
+    uint32_t a = job.mid[0], b = job.mid[1], c = job.mid[2], d = job.mid[3], e = job.mid[4];
+    for (int i = job.first_round; i < 80; i++) {
+        if (i >= 16)
+            W[i & 15] = rotl(W[(i - 3) & 15] ^ W[(i - 8) & 15] ^ W[(i - 14) & 15] ^ W[i & 15], 1);
+        sha1_round(i, a, b, c, d, e, W[i & 15]);
+        if (i == 75 && job.tail_only)
+            return ((0xC3D2E1F0 + rotl(a, 30)) & job.mask[4]) == job.target[4];
+    }
+
+    uint32_t state[5] = { a + 0x67452301, b + 0xEFCDAB89, c + 0x98BADCFE, d + 0x10325476, e + 0xC3D2E1F0 };
+    for (int i = 0; i < 5; i++)
+        if ((state[i] & job.mask[i]) != job.target[i])
+            return false;
+    return true;
+}
+
+#endif
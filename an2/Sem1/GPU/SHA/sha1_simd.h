@@ -0,0 +1,168 @@
+#ifndef SHA1_SIMD_H
+#define SHA1_SIMD_H
+
+// Multi-buffer SHA-1 for the host nonce search: one candidate message per
+// SIMD lane, 4 (SSE2), 8 (AVX2) or 16 (AVX-512F) nonces per call. The rounds
+// are written once with GCC vector extensions and instantiated per width
+// inside functions carrying the matching target attribute, so the binary
+// runs on any x86-64 and select_kernel() picks the widest variant the CPU
+// supports at run time.
+
+#include <cstdint>
+#include <string>
+
+#include "sha1.h"
+
+namespace sha1_simd {
+
+typedef uint32_t u32x4 __attribute__((vector_size(16)));
+typedef uint32_t u32x8 __attribute__((vector_size(32)));
+typedef uint32_t u32x16 __attribute__((vector_size(64)));
+
+// The nonce-independent part of the search (padded block, midstate, suffix
+// as state-word masks) comes from sha1_nonce_job() in sha1.h.
+typedef SHA1_NONCE_JOB NonceJob;
+
+// The helpers are always inlined as well: an out-of-line call would be
+// compiled without the caller's target. They take vectors by reference and
+// the rotation is a macro, because a vector passed or returned by value makes
+// GCC warn (-Wpsabi) in builds without -mavx that its ABI depends on the flags.
+#define SHA1_VROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+// Schedule word i into wi, kept in a rolling window of 16 words.
+template <typename V>
+__attribute__((always_inline)) inline void vschedule(V* W, int i, V& wi) {
+    if (i >= 16) {
+        V x = W[(i - 3) & 15] ^ W[(i - 8) & 15] ^ W[(i - 14) & 15] ^ W[i & 15];
+        W[i & 15] = SHA1_VROTL(x, 1);
+    }
+    wi = W[i & 15];
+}
+
+template <typename V>
+__attribute__((always_inline)) inline void vround(V& a, V& b, V& c, V& d, V& e, const V& f, uint32_t k, const V& wi) {
+    V t = SHA1_VROTL(a, 5) + f + e + wi + k;
+    e = d;
+    d = c;
+    c = SHA1_VROTL(b, 30);
+    b = a;
+    a = t;
+}
+
+// Hashes the nonces first .. first + N - 1 and returns the bitmask of lanes
+// whose hash ends in the suffix. Always inlined into the target-specific
+// wrappers below, so it is compiled for their instruction set.
+template <typename V, int N>
+__attribute__((always_inline)) inline uint32_t search_lanes(const NonceJob& job, uint32_t first) {
+    V W[16];
+    for (int i = 0; i < 16; i++)
+        W[i] = V{} + job.words[i];
+
+    V nonce;
+    for (int l = 0; l < N; l++)
+        nonce[l] = first + l;
+    for (int b = 0; b < 4; b++) {
+        int p = job.nonce_pos + b;
+        W[p / 4] |= ((nonce >> (8 * b)) & 0xFF) << (8 * (3 - p % 4));
+    }
+
+    V a = V{} + job.mid[0], b = V{} + job.mid[1], c = V{} + job.mid[2],
+      d = V{} + job.mid[3], e = V{} + job.mid[4];
+    V wi;
+
+    for (int i = job.first_round; i < 20; i++) {
+        vschedule(W, i, wi);
+        vround(a, b, c, d, e, (b & c) | (~b & d), 0x5A827999, wi);
+    }
+    for (int i = 20; i < 40; i++) {
+        vschedule(W, i, wi);
+        vround(a, b, c, d, e, b ^ c ^ d, 0x6ED9EBA1, wi);
+    }
+    for (int i = 40; i < 60; i++) {
+        vschedule(W, i, wi);
+        vround(a, b, c, d, e, (b & c) | (b & d) | (c & d), 0x8F1BBCDC, wi);
+    }
+    for (int i = 60; i < 76; i++) {
+        vschedule(W, i, wi);
+        vround(a, b, c, d, e, b ^ c ^ d, 0xCA62C1D6, wi);
+    }
+
+    uint32_t hits = 0;
+    if (job.tail_only) {
+        V miss = ((SHA1_VROTL(a, 30) + 0xC3D2E1F0u) & job.mask[4]) ^ job.target[4];
+        for (int l = 0; l < N; l++)
+            if (miss[l] == 0)
+                hits |= 1u << l;
+        return hits;
+    }
+    for (int i = 76; i < 80; i++) {
+        vschedule(W, i, wi);
+        vround(a, b, c, d, e, b ^ c ^ d, 0xCA62C1D6, wi);
+    }
+
+    V state[5] = { a + 0x67452301u, b + 0xEFCDAB89u, c + 0x98BADCFEu, d + 0x10325476u, e + 0xC3D2E1F0u };
+    V miss = V{};
+    for (int i = 0; i < 5; i++)
+        if (job.mask[i])
+            miss |= (state[i] & job.mask[i]) ^ job.target[i];
+
+    for (int l = 0; l < N; l++)
+        if (miss[l] == 0)
+            hits |= 1u << l;
+    return hits;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("sse2"))) inline uint32_t search_sse2(const NonceJob& job, uint32_t first) {
+    return search_lanes<u32x4, 4>(job, first);
+}
+
+__attribute__((target("avx2"))) inline uint32_t search_avx2(const NonceJob& job, uint32_t first) {
+    return search_lanes<u32x8, 8>(job, first);
+}
+
+__attribute__((target("avx512f"))) inline uint32_t search_avx512(const NonceJob& job, uint32_t first) {
+    return search_lanes<u32x16, 16>(job, first);
+}
+
+#endif
+
+// Portable fallback, one nonce per call.
+inline uint32_t search_scalar(const NonceJob& job, uint32_t first) {
+    return sha1_nonce_match(job, first) ? 1 : 0;
+}
+
+struct Kernel {
+    const char* name;
+    int width;
+    uint32_t (*search)(const NonceJob&, uint32_t);
+};
+
+// The values select_kernel() accepts.
+inline bool known_kernel(const std::string& name) {
+    return name == "auto" || name == "avx512" || name == "avx2" || name == "sse2" || name == "scalar";
+}
+
+// "auto" takes the widest variant this CPU runs; a variant it cannot run
+// falls back to auto as well.
+inline Kernel select_kernel(const std::string& want = "auto") {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    bool avx512 = __builtin_cpu_supports("avx512f"), avx2 = __builtin_cpu_supports("avx2"),
+         sse2 = __builtin_cpu_supports("sse2");
+    if (want == "scalar") return { "scalar", 1, search_scalar };
+    if (want == "sse2" && sse2) return { "sse2", 4, search_sse2 };
+    if (want == "avx2" && avx2) return { "avx2", 8, search_avx2 };
+    if (avx512) return { "avx512", 16, search_avx512 };
+    if (avx2) return { "avx2", 8, search_avx2 };
+    if (sse2) return { "sse2", 4, search_sse2 };
+#else
+    (void)want;
+#endif
+    return { "scalar", 1, search_scalar };
+}
+
+} // namespace sha1_simd
+
+#endif